@@ -0,0 +1,55 @@
+//
+// A header file for encoding rgba8 images into the BC1 and BC7 block compressed formats, and decoding them back to
+// measure the loss
+//
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <stdint.h> // uint8_t, uint32_t
+
+#include <vulkan/vulkan_core.h> // VkFormat
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the number of least squares passes over the endpoints after the first fit, each one costs about as much as the
+// first fit and gains less and less
+const uint32_t BC_DEFAULT_REFINEMENTS = 1;
+
+//////////////////////
+//
+// Block compression functions namespace
+//
+//////////////////////
+
+namespace blockcompression {
+
+    // encodes 4x4 rgba8 texels, row by row, into an 8 byte BC1 block in the opaque four colour mode, alpha is ignored.
+    // The endpoints are first fitted along the principal axis of the colours, then refined by least squares on the
+    // chosen indices. The closest palette entry of each texel is found with SSE
+    void encodeBC1Block(const uint8_t texels[64], uint32_t refinements, uint8_t block[8]);
+
+    // encodes 4x4 rgba8 texels into a 16 byte BC7 block in mode 6, a single subset with rgba endpoints and 4 bit indices,
+    // fitted the same way as BC1 blocks
+    void encodeBC7Block(const uint8_t texels[64], uint32_t refinements, uint8_t block[16]);
+
+    // decodes a BC1 block to 4x4 rgba8 texels, in either mode
+    void decodeBC1Block(const uint8_t block[8], uint8_t texels[64]);
+
+    // decodes a BC7 block to 4x4 rgba8 texels. Only mode 6, which is the one written by encodeBC7Block, is handled,
+    // blocks in the other modes are decoded to zero
+    void decodeBC7Block(const uint8_t block[16], uint8_t texels[64]);
+
+    // encodes a whole level of rgba8 texels in BC1 or BC7 (either unorm or sRGB, the texels are encoded as they are).
+    // The edge texels are repeated to fill the partial blocks, the rows of blocks are split between the workers
+    void compressLevel(const uint8_t* texels, uint32_t width, uint32_t height, VkFormat format, uint32_t refinements, uint8_t* blocks);
+
+    // decodes a whole level of BC1 or BC7 blocks to rgba8 texels
+    void decompressLevel(const uint8_t* blocks, uint32_t width, uint32_t height, VkFormat format, uint8_t* texels);
+}
+
+#endif // !BLOCK_COMPRESSION_H
@@ -0,0 +1,43 @@
+//
+// A header file for computing the bounding volumes of a model's vertices
+//
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "Vertex.h" // vertex struct
+
+#include <vector> // vector container
+
+#include <glm/glm.hpp> // shader vectors, matrices ...
+
+// a POD struct containing the bounding volumes of a set of vertices
+struct Bounds {
+    // axis aligned bounding box
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    // the average of the positions
+    glm::vec3 centroid = glm::vec3(0.0f);
+    // a bounding sphere close to the smallest one (Ritter 1990)
+    glm::vec3 sphereCentre = glm::vec3(0.0f);
+    float     sphereRadius = 0.0f;
+};
+
+//////////////////////
+//
+// Bounds functions namespace
+//
+//////////////////////
+
+namespace bounds {
+
+    // computes all the bounds in two passes over the positions, the first one finds the box, the centroid and the
+    // extreme points along each axis, the second one grows the sphere started from the two furthest apart extreme points.
+    // Uses AVX or SSE when compiled in, with computeBoundsScalar as the fallback
+    Bounds computeBounds(const std::vector<Vertex>& vertices);
+
+    // the same computation one vertex at a time
+    Bounds computeBoundsScalar(const std::vector<Vertex>& vertices);
+}
+
+#endif // !BOUNDS_H
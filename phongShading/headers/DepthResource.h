@@ -22,7 +22,7 @@ public:
     // Create and destroy the depth resource
     //
     
-    void createDepthResource(const VulkanSetup* vkSetup, const VkExtent2D& extent, VkCommandPool commandPool);
+    void createDepthResource(VulkanSetup* vkSetup, const VkExtent2D& extent, VkCommandPool commandPool);
 
     void cleanupDepthResource();
 
@@ -50,7 +50,7 @@ public:
     VkImageView depthImageView;
 
     // the memory containing the depth image data
-    VkDeviceMemory depthImageMemory;
+    MemoryAllocation depthImageMemory;
 };
 
 
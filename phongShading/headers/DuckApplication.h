@@ -5,8 +5,12 @@
 #ifndef DUCK_APPLICATION_H
 #define DUCK_APPLICATION_H
 
-#include <Texture.h> // the texture class
+#include <TextureCache.h> // the texture class and its cache
+#include <UploadBatcher.h> // batched uploads
+#include <TextureTable.h> // the textures bound for the shaders
 #include <Model.h> // the model class
+#include <GeometryArena.h> // the vertices and indices of the models
+#include <UniformRing.h> // the uniforms of each frame
 #include <Vertex.h> // the vertex struct
 #include <VulkanSetup.h> // include the vulkan setup class
 #include <SwapChainData.h> // the swap chain class
@@ -30,6 +34,8 @@
 #include <string>
 // value wrapper
 #include <optional>
+// SIZE_MAX
+#include <cstdint>
 
 //
 // Helper structs
@@ -45,7 +51,7 @@ struct UniformBufferObject {
     alignas(16) glm::vec3 ambient; int uvToRgb; // 16 byte alignment (vec3(12B) + int(4B) = 16B)
     alignas(16) glm::vec3 diffuse; int useTexture;
     glm::vec4 specular; // vec4 = 4 floats = 16 bytes
-    glm::vec3 lightPos = { 0, -3, 0 }; // /!\ not aligned, but okay because it is the last element in the buffer
+    glm::vec3 lightPos = { 0, -3, 0 };
 };
 
 
@@ -81,6 +87,9 @@ private:
 
     void createDescriptorSets();
 
+    // points the descriptor set of a swap chain image to the current texture view and records its command buffer again
+    void updateTextureDescriptor(size_t imageIndex);
+
     void createUniformBuffers();
 
     void createTextureSampler();
@@ -91,15 +100,18 @@ private:
 
     void createCommandBuffers(std::vector<VkCommandBuffer>* commandBuffers, VkCommandPool& commandPool);
 
-    void recordGemoetryCommandBuffer();
+    // records the geometry command buffers of imageCount swap chain images from firstImage, all of them by default
+    void recordGemoetryCommandBuffer(size_t firstImage = 0, size_t imageCount = SIZE_MAX);
 
     //--------------------------------------------------------------------//
     
     void loadModel(); 
 
-    void createVertexBuffer();
+    void createGeometryArena();
+
+    void createIndirectBuffers();
 
-    void createIndexBuffer();
+    void createMaterialBuffer();
 
     //--------------------------------------------------------------------//
 
@@ -118,6 +130,8 @@ private:
 
     void updateUniformBuffer(uint32_t currentImage);
 
+    void updateDrawCommands(uint32_t currentImage, const glm::mat4& proj, const glm::mat4& modelView);
+
     //--------------------------------------------------------------------//
 
     // destroys everything properly
@@ -149,20 +163,40 @@ private:
     // object data
     Model duckModel;
 
-    // texture data
-    Texture duckTexture;
+    // persistently mapped memory the textures and buffers are loaded into before being copied to the device
+    StagingBuffer stagingBuffer;
+    // the copies and barriers of the loading phase, submitted at once
+    UploadBatcher uploadBatcher;
 
-    // vertex buffer
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-
-    // index buffer
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
-
-    // uniform buffers
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    // texture data
+    TextureCache textureCache;
+    Texture* duckTexture;
+    // every texture in use, bound once and indexed by the materials
+    TextureTable textureTable;
+
+    // the vertices and indices of every mesh, and the ranges of the duck in them
+    GeometryArena geometryArena;
+    GeometryRange duckGeometry;
+
+    // the model's material table, a storage buffer indexed by the material index of each draw
+    VkBuffer materialBuffer;
+    MemoryAllocation materialBufferMemory;
+
+    // the uniforms of every swap chain image in one mapped buffer, and the dynamic offset each image binds them at
+    UniformRing uniformRing;
+    std::vector<uint32_t> uniformOffsets;
+
+    // indirect draw buffers, one per swap chain image like the uniforms, filled with the draws of the visible meshlets
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<MemoryAllocation> indirectBuffersMemory;
+    // the number of draws in each buffer, all of them are issued every frame
+    uint32_t indirectDrawCount = 1;
+    // the draws of the current frame, how many of them draw something and the number of meshlets they cover
+    std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+    uint32_t activeDraws = 0;
+    uint32_t visibleMeshlets = 0;
+    // the level of detail drawn this frame
+    uint32_t currentLod = 0;
 
 
     // Variables changed by the UI
@@ -180,6 +214,9 @@ private:
     bool uvToRgb = false;
     bool useTexture = true;
     bool centreModel = false;
+    bool enableMeshletCulling = true;
+    int forcedLod = -1; // -1 picks the level from the size on screen
+    float lodErrorThreshold = 1.0f;
 
     float ambient[3] = { 0.1f, 0.1f, 0.1f };
     float diffuse[3] = { 0.5f, 0.5f, 0.5f };
@@ -192,6 +229,8 @@ private:
     VkDescriptorPool descriptorPool;
     VkDescriptorPool imGuiDescriptorPool;
     std::vector<VkDescriptorSet> descriptorSets; // descriptor set handles
+    // the sets still pointing to the texture's placeholder, by swap chain image
+    std::vector<bool> staleTextureDescriptors;
    
 
     // command buffers
@@ -0,0 +1,92 @@
+//
+// A single device local buffer holding the vertices and indices of every mesh. The buffer is split into a position
+// stream, an attribute stream and an index section, each mesh gets a range of vertices and a range of indices in them.
+// The arena is bound once and the draws pick their mesh with firstIndex and vertexOffset, so that meshes can be drawn
+// without rebinding and from the same indirect draw
+//
+
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include "VulkanSetup.h" // for referencing the device
+#include "StagingBuffer.h" // the meshes are written into staging memory
+#include "UploadBatcher.h" // and copied to the arena with the rest of the loading
+#include "Model.h" // model class
+
+#include <stdint.h> // uint32_t
+
+#include <map> // free ranges by first element
+
+#include <vulkan/vulkan_core.h>
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the number of vertices and indices the arena has room for, shared by every mesh
+const uint32_t GEOMETRY_ARENA_VERTICES = 1 << 20;
+const uint32_t GEOMETRY_ARENA_INDICES  = 1 << 22;
+
+//////////////////////
+//
+// Geometry ranges
+//
+//////////////////////
+
+// a POD struct containing the ranges of a mesh in the arena. The indices of the mesh are relative to its first vertex,
+// which is the vertexOffset of its draws, and its firstIndex is added to the first index of each of its draws
+struct GeometryRange {
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex  = 0;
+    uint32_t indexCount  = 0;
+};
+
+class GeometryArena {
+public:
+    // creates the buffer, attributeStride is the size of the attributes of one vertex in the format of the pipeline
+    void createGeometryArena(VulkanSetup* pVkSetup, StagingBuffer* pStagingBuffer, UploadBatcher* pUploadBatcher, VkDeviceSize attributeStride);
+
+    // allocates the ranges of the model and records the upload of its vertex streams and indices into the current batch
+    // with a single copy command. Throws if the arena is too full
+    GeometryRange addMesh(const Model& model);
+
+    // frees the ranges of a mesh that is no longer drawn
+    void removeMesh(GeometryRange& range);
+
+    // binds the streams and the indices, once for every mesh of the arena
+    void bind(VkCommandBuffer commandBuffer) const;
+
+    void cleanupGeometryArena();
+
+private:
+    // first fit allocation of count consecutive elements from the free ranges, returns false if none is large enough
+    static bool allocateRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t count, uint32_t& first);
+
+    // returns a range to the free ranges, merged with its free neighbours
+    static void freeRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t first, uint32_t count);
+
+public:
+    VulkanSetup* vkSetup;
+
+    // the one buffer, the position stream then the attribute stream then the indices
+    VkBuffer buffer;
+    MemoryAllocation bufferMemory;
+
+private:
+    StagingBuffer* stagingBuffer;
+    UploadBatcher* uploadBatcher;
+
+    // the start of each section in the buffer
+    VkDeviceSize attributeStride;
+    VkDeviceSize attributeOffset;
+    VkDeviceSize indexOffset;
+
+    // the free vertices and indices, the size of each free range by its first element
+    std::map<uint32_t, uint32_t> freeVertices;
+    std::map<uint32_t, uint32_t> freeIndices;
+};
+
+#endif // !GEOMETRY_ARENA_H
@@ -0,0 +1,108 @@
+//
+// A header file for reading and writing KTX2 textures in block compressed formats, with their mip chain already built
+//
+
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <stdint.h> // uint8_t, uint32_t, uint64_t
+
+#include <functional> // function wrapper
+#include <string> // string for texture path
+#include <vector> // vector container
+
+#include <vulkan/vulkan_core.h> // VkFormat, VkDeviceSize
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the extension of the compressed version of a texture, looked for next to the source image
+const std::string KTX2_EXTENSION = ".ktx2";
+
+// the first bytes of every KTX2 file, "«KTX 20»\r\n\x1A\n"
+const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// the BC formats are made of blocks of 4x4 texels
+const uint32_t KTX2_BLOCK_DIMENSION = 4;
+
+//////////////////////
+//
+// File layout
+//
+//////////////////////
+
+// a POD struct containing the fixed size header at the start of a KTX2 file, followed by one Ktx2LevelIndex per level
+struct Ktx2Header {
+    uint8_t  identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount; // 0 asks the loader to generate the chain, which can't be done for compressed formats
+    uint32_t supercompressionScheme;
+
+    // the data format descriptor, key/value and supercompression global data blocks
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+// a POD struct containing where a level is in the file, level 0 being the largest
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// a POD struct containing a texture read from a KTX2 file
+struct Ktx2Texture {
+    VkFormat                  format     = VK_FORMAT_UNDEFINED;
+    uint32_t                  width      = 0;
+    uint32_t                  height     = 0;
+    uint32_t                  levelCount = 0;
+    // the levels one after the other from the largest, each one at its offset in data. Left empty when the levels are
+    // read into memory given to loadKtx2
+    std::vector<VkDeviceSize> levelOffsets;
+    std::vector<uint8_t>      data;
+};
+
+//////////////////////
+//
+// KTX2 functions namespace
+//
+//////////////////////
+
+namespace ktx2 {
+
+    // true for the formats that can be read, BC1, BC3 and BC7 either unorm or sRGB
+    bool isSupportedFormat(VkFormat format);
+
+    // the size in bytes of a 4x4 block of one of the supported formats
+    uint32_t blockSize(VkFormat format);
+
+    // the size in bytes of a width x height level, a partial block on the edges counts as a whole one
+    VkDeviceSize levelSize(VkFormat format, uint32_t width, uint32_t height);
+
+    // reads a 2D texture from the file at path, throws if the file is malformed or holds anything else than a single
+    // 2D image in one of the supported formats without supercompression
+    void loadKtx2(const std::string& path, Ktx2Texture& texture);
+
+    // the same, but the levels are read into the memory returned by allocateData, which is called once with the size
+    // of the whole chain, rather than into texture.data. Lets the levels be read straight into staging memory
+    void loadKtx2(const std::string& path, Ktx2Texture& texture, const std::function<uint8_t*(VkDeviceSize size)>& allocateData);
+
+    // writes the texture to a ktx2 file at path, with the data format descriptor of its format and the levels aligned
+    // on their block size. Throws if the file can't be written
+    void writeKtx2(const std::string& path, const Ktx2Texture& texture);
+}
+
+#endif // !KTX2_H
@@ -0,0 +1,155 @@
+//
+// A device memory allocator that sub-allocates buffers and images from large blocks of device memory rather than
+// calling vkAllocateMemory for every resource. The free space of each block is kept by a two level segregated fit
+// (TLSF) allocator, which finds a free region of at least the requested size in constant time and merges freed
+// regions with their free neighbours
+//
+
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+
+#include <stdint.h> // uint8_t, uint32_t, uint64_t
+
+#include <mutex> // the staging buffer allocates from the decoding threads
+#include <vector> // vector container
+
+#include <vulkan/vulkan_core.h>
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the size of the blocks of device memory, smaller for small heaps. Larger resources get a block of their own
+const VkDeviceSize MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+
+//////////////////////
+//
+// Allocations
+//
+//////////////////////
+
+// a POD struct containing a region of a block of device memory, bound to a resource at offset
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize   offset = 0;
+    VkDeviceSize   size   = 0;
+    // the start of the region for host visible memory, whose blocks stay mapped as a block can only be mapped once
+    uint8_t*       mapped = nullptr;
+    // the pool and region the allocation came from, for freeing it
+    uint32_t       pool   = 0;
+    uint32_t       region = 0;
+};
+
+// a POD struct containing the current use of device memory
+struct MemoryStats {
+    // the resources sub-allocated, and the vkAllocateMemory calls they share
+    size_t       allocationCount = 0;
+    size_t       blockCount      = 0;
+    VkDeviceSize allocatedBytes  = 0;
+    VkDeviceSize blockBytes      = 0;
+};
+
+class MemoryAllocator {
+public:
+    void createMemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+
+    // a region of memory of the first type with properties that the requirements allow, aligned as required. Linear
+    // resources (buffers and linear images) and optimal images are allocated from separate blocks whenever the device
+    // has a bufferImageGranularity, so they never share a page. Can be called from any thread
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+
+    // returns the region to its block once the resource bound to it is destroyed. An empty block is released unless it
+    // is the last of its pool. Can be called from any thread
+    void free(MemoryAllocation& allocation);
+
+    MemoryStats getStats();
+
+    // releases every block, every allocation must have been freed
+    void cleanupMemoryAllocator();
+
+private:
+    // the free regions are kept in lists by size class. The first level is the power of two of the size and the second
+    // level splits each power of two into SL_COUNT classes, sizes under SMALL_SIZE share the first list
+    static constexpr uint32_t     SL_LOG2    = 5;
+    static constexpr uint32_t     SL_COUNT   = 1 << SL_LOG2;
+    static constexpr uint32_t     FL_SHIFT   = 8;
+    static constexpr uint32_t     FL_COUNT   = 48;
+    static constexpr VkDeviceSize SMALL_SIZE = VkDeviceSize(1) << FL_SHIFT;
+    static constexpr uint32_t     NO_REGION  = UINT32_MAX;
+
+    // a POD struct containing a region of a block, used or free, linked to its neighbours in the block and, when free,
+    // to the other free regions of its size class
+    struct Region {
+        VkDeviceSize offset       = 0;
+        VkDeviceSize size         = 0;
+        uint32_t     block        = 0;
+        uint32_t     prevPhysical = NO_REGION;
+        uint32_t     nextPhysical = NO_REGION;
+        uint32_t     prevFree     = NO_REGION;
+        uint32_t     nextFree     = NO_REGION;
+        bool         free         = true;
+    };
+
+    // a POD struct containing a block of device memory, mapped for its lifetime if it is host visible
+    struct Block {
+        VkDeviceMemory memory      = VK_NULL_HANDLE;
+        VkDeviceSize   size        = 0;
+        uint8_t*       mapped      = nullptr;
+        uint32_t       usedRegions = 0;
+    };
+
+    // a POD struct containing the blocks of one memory type, for either linear or optimal resources, and the free
+    // lists of their regions with a bitmap of the lists that aren't empty
+    struct Pool {
+        uint32_t           memoryType = 0;
+        std::vector<Block> blocks;
+        uint64_t           flBitmap   = 0;
+        uint32_t           slBitmaps[FL_COUNT];
+        uint32_t           heads[FL_COUNT][SL_COUNT];
+    };
+
+    // the size class a free region of size goes in
+    static void mappingInsert(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+
+    // the first size class whose regions are all at least size
+    static void mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+
+    // a free region of pool of at least size, or NO_REGION
+    uint32_t findFreeRegion(Pool& pool, VkDeviceSize size);
+
+    void insertFreeRegion(Pool& pool, uint32_t region);
+
+    void removeFreeRegion(Pool& pool, uint32_t region);
+
+    // a region record, reusing those of merged regions
+    uint32_t newRegion();
+
+    void deleteRegion(uint32_t region);
+
+    // splits the region at offset within it, returning the second part which follows it in the block
+    uint32_t splitRegion(uint32_t region, VkDeviceSize offset);
+
+    // allocates a block of size for pool with a single free region, returns the region
+    uint32_t createBlock(Pool& pool, VkDeviceSize size);
+
+    void destroyBlock(Block& block);
+
+public:
+    VkDevice device;
+
+private:
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize bufferImageGranularity;
+
+    // two pools per memory type, the second one is for optimal images
+    std::vector<Pool> pools;
+    std::vector<Region> regions;
+    // the records of merged regions
+    std::vector<uint32_t> unusedRegions;
+
+    std::mutex mutex;
+};
+
+#endif // !MEMORY_ALLOCATOR_H
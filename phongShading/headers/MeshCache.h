@@ -0,0 +1,97 @@
+//
+// A binary cache for loaded models, written the first time an obj file is parsed and memory mapped on
+// later runs so that the text parsing and mesh processing can be skipped entirely
+//
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "Model.h" // model class
+
+#include <stdint.h> // uint32_t, uint64_t
+
+#include <string> // string for model path
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// appended to the source path to get the path of the cache file
+const std::string MESH_CACHE_EXTENSION = ".meshcache";
+
+// identifies a mesh cache file, and the version of its layout. Bump the version whenever the layout of the header,
+// the Vertex struct or the processing applied to the mesh changes so that stale caches are rebuilt
+const char     MESH_CACHE_MAGIC[4]  = { 'M', 'S', 'H', 'C' };
+const uint32_t MESH_CACHE_VERSION   = 6;
+
+// the data blocks start on this alignment in the file
+const uint64_t MESH_CACHE_ALIGNMENT = 64;
+
+//////////////////////
+//
+// Cache layout
+//
+//////////////////////
+
+// a POD struct at the start of a cache file, followed by the vertex, index, submesh and material blocks. Only fixed
+// width types go in it, so that the layout doesn't change between 32 and 64 bit builds
+struct MeshCacheHeader {
+    // file identification
+    char       magic[4];
+    uint32_t   version;
+
+    // the key, the cache is only used if all of these match the source file and the loading options
+    uint64_t   sourcePathHash;
+    uint64_t   sourceSize;
+    int64_t    sourceModified;
+    uint32_t   vertexStride;
+    uint32_t   flags; // the processing options of the model that change its data
+
+    // the bounds block, the centre of gravity and span are derived from it
+    Bounds     bounds;
+
+    // the statistics gathered when the mesh was processed
+    ModelStats stats;
+
+    // the levels of detail, ranges of the index and submesh blocks
+    uint32_t   lodCount;
+    ModelLod   lods[MODEL_MAX_LODS];
+
+    // location of the blocks in the file
+    uint64_t   vertexCount;
+    uint64_t   vertexOffset;
+    uint64_t   indexCount;
+    uint64_t   indexOffset;
+    uint64_t   submeshCount;
+    uint64_t   submeshOffset;
+    uint64_t   materialCount;
+    uint64_t   materialOffset;
+};
+
+//////////////////////
+//
+// Reading and writing
+//
+//////////////////////
+
+struct MeshCache {
+    // fills the model from the cache of the file at path, returns false if there is no cache or it is out of date
+    static bool readCache(const std::string& path, Model& model);
+
+    // writes the model's processed data to the cache of the file at path, returns false if it could not be written
+    static bool writeCache(const std::string& path, const Model& model);
+
+private:
+
+    // fills in the key part of a header from the source file, returns false if the source can't be queried
+    static bool makeKey(const std::string& path, const Model& model, MeshCacheHeader& header);
+
+    // read only memory mapping of a whole file, returns nullptr if it can't be mapped
+    static const void* mapFile(const std::string& path, size_t& size);
+
+    static void unmapFile(const void* data, size_t size);
+};
+
+#endif // !MESH_CACHE_H
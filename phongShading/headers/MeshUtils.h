@@ -0,0 +1,111 @@
+//
+// A header file for the mesh processing passes applied to a model once it has been loaded
+//
+
+#ifndef MESH_UTILS_H
+#define MESH_UTILS_H
+
+#include "Vertex.h" // vertex struct
+
+#include <stdint.h> // uint32_t
+
+#include <vector> // vector container
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the number of entries in the simulated post-transform vertex cache, typical of current hardware
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+// the simulated pre-transform (vertex fetch) cache, a small fifo cache of memory lines
+const uint32_t FETCH_CACHE_LINE_SIZE = 64;
+const uint32_t FETCH_CACHE_LINES     = 64;
+
+//////////////////////
+//
+// Vertex welding
+//
+//////////////////////
+
+// a flat open addressing hash table that welds together vertices with identical attributes as they are inserted,
+// so that a mesh loaded one vertex per face corner can be turned into unique vertices and an index buffer
+class VertexWelder {
+    //////////////////////
+    //
+    // MEMBER FUNCTIONS
+    //
+    //////////////////////
+
+public:
+
+    // sizes the table for at most maxVertices unique vertices, the table is never resized after this
+    void initWelder(size_t maxVertices);
+
+    // returns the index of the vertex in vertices, appending it first if no identical vertex was inserted before
+    uint32_t insertVertex(const Vertex& vertex, std::vector<Vertex>& vertices);
+
+private:
+
+    static uint32_t hashVertex(const Vertex& vertex);
+
+    //////////////////////
+    //
+    // MEMBER VARIABLES
+    //
+    //////////////////////
+
+private:
+    // the slots of the table, each one contains an index into the vertices or EMPTY_SLOT
+    std::vector<uint32_t> slots;
+
+    // the number of slots minus one, the number of slots is a power of two so this is used for wrapping around
+    uint32_t mask = 0;
+
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+};
+
+//////////////////////
+//
+// Mesh processing functions namespace
+//
+//////////////////////
+
+namespace meshutils {
+
+    //
+    // Post-transform vertex cache
+    //
+
+    // average cache miss ratio, the number of vertices shaded per triangle when drawing the indices through a fifo cache
+    float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+
+    // reorders the triangles so that consecutive triangles reuse recently transformed vertices (tipsify, Sander et al. 2007)
+    void optimiseVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+
+    //
+    // Vertex fetch
+    //
+
+    // the number of memory lines missed when fetching the indexed vertices of the given stride through a fifo cache
+    size_t computeFetchMisses(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexStride, uint32_t lineSize, uint32_t cacheLines);
+
+    // rewrites the vertices in the order they are first referenced by the indices and remaps the indices accordingly, 
+    // vertices that are never referenced are dropped
+    void optimiseVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+    //
+    // Normals
+    //
+
+    // smooth normals for triangles indexing a flat array of positions (x, y, z), each position gets the sum of the
+    // normals of the faces around it weighted by their area, normalised. The triangles are split between the workers,
+    // each one accumulating into its own buffer over the range of positions its triangles use, then a second parallel
+    // pass over the positions adds up the buffers, so no atomics are needed. Positions that are not used by any
+    // triangle, or only by degenerate ones, get a zero normal
+    std::vector<glm::vec3> generateNormals(const std::vector<float>& positions, const std::vector<uint32_t>& positionIndices);
+}
+
+#endif // !MESH_UTILS_H
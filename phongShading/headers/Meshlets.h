@@ -0,0 +1,77 @@
+//
+// A header file for splitting a model into meshlets, small clusters of triangles with their own bounds, and for
+// culling them on the cpu to build the list of draws for a frame
+//
+
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "Vertex.h" // vertex struct
+
+#include <stdint.h> // uint32_t
+
+#include <vector> // vector container
+
+#include <glm/glm.hpp> // shader vectors, matrices ...
+
+#include <vulkan/vulkan_core.h>
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the size limits of a meshlet, the usual limits for mesh shaders so that the same clusters could be used by them
+const uint32_t MESHLET_MAX_VERTICES  = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+//////////////////////
+//
+// Meshlet
+//
+//////////////////////
+
+// a POD struct containing a cluster of consecutive triangles of the index buffer and the bounds used to cull it
+struct Meshlet {
+    // the range of the model's index buffer drawn by the meshlet
+    uint32_t  firstIndex  = 0;
+    uint32_t  indexCount  = 0;
+    // the number of unique vertices referenced by the triangles
+    uint32_t  vertexCount = 0;
+    // the material of all the triangles, the meshlets of a submesh take its material
+    uint32_t  materialIndex = 0;
+
+    // bounding sphere of the vertices
+    glm::vec3 centre = glm::vec3(0.0f);
+    float     radius = 0.0f;
+
+    // cone containing the normals of the triangles. The meshlet is entirely back facing when seen from anywhere in
+    // the cone's direction beyond the sine of its half angle, stored in coneCutoff. A cutoff of 1 disables the test
+    glm::vec3 coneAxis   = glm::vec3(0.0f, 0.0f, 1.0f);
+    float     coneCutoff = 1.0f;
+};
+
+//////////////////////
+//
+// Meshlet functions namespace
+//
+//////////////////////
+
+namespace meshlets {
+
+    // partitions the triangles of a range of the indices into meshlets in index buffer order, starting a new meshlet
+    // whenever adding a triangle would go over MESHLET_MAX_VERTICES or MESHLET_MAX_TRIANGLES, computes the bounds of
+    // each one and appends them to meshlets. The range is a single submesh, so all the meshlets get its material
+    void buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount,
+        uint32_t materialIndex, std::vector<Meshlet>& meshlets);
+
+    // tests a range of the meshlets against the view frustum of modelViewProj and against the camera position in model
+    // space, and fills drawCommands with the visible ones. Meshlets that are next to each other in the index buffer and
+    // share their material are merged into a single draw, whose first instance is the material index. Returns the
+    // number of visible meshlets
+    uint32_t cullMeshlets(const std::vector<Meshlet>& meshlets, uint32_t firstMeshlet, uint32_t meshletCount, const glm::mat4& modelViewProj,
+        const glm::vec3& cameraPosition, std::vector<VkDrawIndexedIndirectCommand>& drawCommands);
+}
+
+#endif // !MESHLETS_H
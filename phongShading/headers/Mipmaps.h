@@ -0,0 +1,44 @@
+//
+// A header file for building the mip chain of a texture on the cpu, the fallback for formats the gpu can't blit
+// with linear filtering
+//
+
+#ifndef MIPMAPS_H
+#define MIPMAPS_H
+
+#include <stdint.h> // uint8_t, uint32_t
+
+#include <stddef.h> // size_t
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the number of linear values the sRGB encoding table has, enough for every 8 bit sRGB value to round trip
+const uint32_t MIPMAPS_LINEAR_STEPS = 4096;
+
+//////////////////////
+//
+// Mipmap functions namespace
+//
+//////////////////////
+
+namespace mipmaps {
+
+    // the number of levels of a full chain, down to 1x1
+    uint32_t levelCount(uint32_t width, uint32_t height);
+
+    // the size in bytes of the first levels of a chain of 4 byte texels, the levels are laid out one after the other
+    // from the largest, each one tightly packed row by row
+    size_t chainSize(uint32_t width, uint32_t height, uint32_t levels);
+
+    // fills in the levels after the first of a chain of rgba8 texels laid out as above, the first level must already
+    // be in place. Each texel is the average of the 2x2 texels of the level above, the last row or column is repeated
+    // for odd sizes. sRGB colours are averaged in linear space as a blit would, alpha is always linear. The rows of a
+    // level are split between the workers and each texel is averaged with SSE
+    void generateChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levels, bool srgb);
+}
+
+#endif // !MIPMAPS_H
@@ -6,31 +6,166 @@
 #define MODEL_H
 
 #include "Vertex.h" // vertex struct
+#include "Meshlets.h" // meshlet struct
+#include "Bounds.h" // bounds struct
+
+#include <stdint.h> // uint32_t, uint64_t
 
 #include <string> // string for model path
 #include <vector> // vector container
 
 #include <vulkan/vulkan_core.h>
 
+// a POD struct containing statistics about the model's geometry, gathered while loading it. It is stored in the mesh
+// cache, so its fields have the same size in every build
+struct ModelStats {
+    // number of vertices referenced by the faces, ie before welding
+    uint64_t faceCorners    = 0;
+    // number of vertices left once identical vertices are welded together
+    uint64_t uniqueVertices = 0;
+    // vertex buffer memory lines fetched through a simulated cache, before and after reordering the vertices
+    uint64_t fetchMissesBefore = 0;
+    uint64_t fetchMissesAfter  = 0;
+    // face corners per unique vertex, how many times fewer vertices are uploaded than without an index buffer
+    float    dedupeRatio    = 1.0f;
+    // average cache miss ratio (vertices shaded per triangle) in the obj's triangle order and after reordering
+    float    acmrBefore     = 0.0f;
+    float    acmrAfter      = 0.0f;
+};
+
+// a POD struct containing the colours of a material from the obj's mtl file, one entry of the material table read by
+// the fragment shader, so it follows std430 packing rules (mirrored in shader.frag!!!). The colours multiply the light
+// colours set in the UI, which is why the default material is all white
+struct Material {
+    // ambient colour (Ka), w unused
+    glm::vec4 ambient  = glm::vec4(1.0f);
+    // diffuse colour (Kd), w unused
+    glm::vec4 diffuse  = glm::vec4(1.0f);
+    // specular colour (Ks) and exponent (Ns), an exponent of 0 uses the one set in the UI
+    glm::vec4 specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    // the slot of the diffuse texture in the texture table, set by the application once its textures are in the table
+    uint32_t  textureIndex = 0;
+    // pads the struct to the 16 byte alignment std430 gives it in the table
+    uint32_t  padding[3]   = { 0, 0, 0 };
+};
+
+// a POD struct containing the triangles of one level of detail that use the same material, a part of the index buffer
+struct Submesh {
+    uint32_t firstIndex    = 0;
+    uint32_t indexCount    = 0;
+    // the entry of the material table, passed to the shaders as the first instance of the draw
+    uint32_t materialIndex = 0;
+};
+
+// the most levels of detail a model can have, the full resolution mesh included
+const uint32_t MODEL_MAX_LODS = 8;
+
+// the simplification stops once a level would have fewer triangles than this
+const uint32_t MODEL_MIN_LOD_TRIANGLES = 64;
+
+// a POD struct containing one level of detail of the model, a part of the index buffer over the shared vertices
+struct ModelLod {
+    uint32_t firstIndex   = 0;
+    uint32_t indexCount   = 0;
+    // the triangles grouped by material, in material order
+    uint32_t firstSubmesh = 0;
+    uint32_t submeshCount = 0;
+    // the meshlets covering the same triangles
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+    // how far the simplified surface may be from the full resolution one, in model space
+    float    error        = 0.0f;
+};
+
 class Model {
 public:
-    // for now only loads in an obj file
+    // for now only loads in an obj file, or its binary cache if it is up to date
 	void loadModel(const std::string& path);
 
+    // the coarsest level of detail whose error stays under maxErrorPixels when the model spans projectedSpan pixels
+    uint32_t selectLod(float projectedSpan, float maxErrorPixels) const;
+
+private:
+
+    // parses the obj file and its materials, welds its face corners into unique vertices and indices and groups the
+    // triangles by material
+    void loadObj(const std::string& path);
+
+    // reorders the indices and vertices for the vertex caches
+    void optimiseMesh();
+
+    // appends the simplified levels of detail to the indices, each one has half the triangles of the previous one.
+    // The submeshes are simplified separately so that the triangles of a level stay grouped by material
+    void buildLods();
+
+    // computes the bounds of the model, and its centre of gravity and span from them
+    void computeBounds();
+
+public:
+    // the sizes in bytes of the position stream and of the attribute stream in the format set by packVertexAttributes
+    size_t positionStreamSize() const;
+    size_t attributeStreamSize() const;
+
+    // writes the position and attribute streams from the vertices on all cores, straight into the memory they are
+    // uploaded from. The streams must be positionStreamSize() and attributeStreamSize() bytes
+    void writeVertexStreams(void* positionStream, void* attributeStream) const;
+
 public:
     //
     // object data
     //
 
-    // the largest distance between any two vertices
+    // the diameter of the bounding sphere, at least the largest distance between any two vertices
     float modelSpan = 0;
 
     // the centre of gravity of the model
-    glm::vec3 centreOfGravity;
+    glm::vec3 centreOfGravity = glm::vec3(0.0f);
+
+    // bounding box and sphere for culling, in model space
+    Bounds bounds;
+
+    // the material table, uploaded as is. Faces without a material use a default one added at the end
+    std::vector<Material> materials;
 
-    // vertex and index data
+    // vertex and index data, the indices of the levels of detail follow each other starting with the full resolution
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    std::vector<ModelLod> lods;
+    // the triangles of each level of detail grouped by material, the vertices are shared by all the materials
+    std::vector<Submesh> submeshes;
+
+    // clusters of consecutive triangles of the index buffer with the bounds used to cull them, empty if disabled. Each
+    // level of detail has its own, and a meshlet never spans two submeshes
+    std::vector<Meshlet> meshlets;
+
+    // statistics about the loaded geometry
+    ModelStats stats;
+
+    //
+    // Flags
+    //
+
+    // rewrite the vertices in the order they are first used by the indices when loading
+    bool enableVertexFetchOptimisation = true; // default
+
+    // load from (and write) a binary cache next to the obj file instead of parsing the text every time
+    bool enableMeshCache = true; // default
+
+    // parse the obj file on all cores with objparser rather than with tinyobj
+    bool useParallelObjParser = true; // default
+
+    // replace the normals of the obj with generated smooth ones, they are only generated for the face corners that
+    // lack one otherwise
+    bool recomputeNormals = false; // default
+
+    // write the attribute stream packed rather than at full precision, set to match the vertex format of the pipeline
+    bool packVertexAttributes = true; // default
+
+    // split the triangles into meshlets so that they can be culled before drawing
+    bool enableMeshlets = true; // default
+
+    // generate simplified levels of detail when loading
+    bool enableLods = true; // default
 };
 
 #endif // !MODEL_H
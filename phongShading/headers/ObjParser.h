@@ -0,0 +1,59 @@
+//
+// A multi-threaded obj parser, an alternative to tinyobj::LoadObj for large files. It only reads the
+// geometry (v, vn, vt and f records) and the materials (mtllib and usemtl records) and produces the same
+// attribute arrays as tinyobj so that the model can be built from either
+//
+
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <string> // string for file path
+#include <vector> // vector container
+#include <map> // material names
+
+#include <tiny_obj_loader.h> // attrib_t and index_t
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the smallest chunk of the file given to a worker, smaller files are parsed by fewer workers
+const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+// the size of the generated mesh used by the benchmark
+const size_t OBJ_BENCHMARK_TRIANGLES = 10000000;
+
+//////////////////////
+//
+// Obj parser functions namespace
+//
+//////////////////////
+
+namespace objparser {
+
+    // parses the obj file at path, splitting it into line aligned chunks that are parsed concurrently. Faces are
+    // triangulated as fans and their corners are appended to indices, three per triangle, and the material of each
+    // triangle to materialIds. Missing attributes and materials have an index of -1, as with tinyobj. The mtl files
+    // are looked for next to the obj file and read with tinyobj::LoadMtl, a missing one is not an error
+    void loadObjParallel(const std::string& path, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices,
+        std::vector<int>& materialIds, std::vector<tinyobj::material_t>& materials);
+
+    // reads the first file of the names of an mtllib record that exists in directory, as tinyobj does
+    void loadMaterialLibrary(const std::string& directory, const std::string& names, std::map<std::string, int>& materialMap,
+        std::vector<tinyobj::material_t>& materials);
+
+    //
+    // Benchmark
+    //
+
+    // writes a grid mesh with positions, normals and texture coordinates made of at least triangleCount triangles
+    void writeSyntheticObj(const std::string& path, size_t triangleCount);
+
+    // times tinyobj::LoadObj against loadObjParallel on each of the files, and the generation of smooth normals for
+    // them, and prints the results
+    void runBenchmark(const std::vector<std::string>& paths);
+}
+
+#endif // !OBJ_PARSER_H
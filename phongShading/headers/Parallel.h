@@ -0,0 +1,28 @@
+//
+// A header file for running work on all of the cpu cores
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h> // uint32_t
+
+#include <functional> // function wrapper
+
+//////////////////////
+//
+// Parallel functions namespace
+//
+//////////////////////
+
+namespace parallel {
+
+    // the number of workers used by parallelFor, one per hardware thread
+    uint32_t workerCount();
+
+    // splits [0, count) into one contiguous range per worker and runs task(begin, end, worker) on each range concurrently.
+    // Returns once every range is done, rethrowing the first exception thrown by a worker if any
+    void parallelFor(size_t count, const std::function<void(size_t begin, size_t end, uint32_t worker)>& task);
+}
+
+#endif // !PARALLEL_H
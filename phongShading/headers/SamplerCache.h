@@ -0,0 +1,76 @@
+//
+// A cache of samplers shared by every texture, a sampler is only created once for each distinct configuration
+// and destroyed when the last texture using it releases it
+//
+
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include "VulkanSetup.h" // for referencing the device
+
+#include <stdint.h> // uint32_t, uint64_t
+
+#include <array> // array container
+#include <unordered_map> // samplers by configuration
+
+#include <vulkan/vulkan_core.h>
+
+//////////////////////
+//
+// Cache key
+//
+//////////////////////
+
+// a POD struct containing the fields of a VkSamplerCreateInfo that configure the sampler, one word each with the
+// floats kept as their bits
+struct SamplerKey {
+    std::array<uint32_t, 16> words;
+
+    bool operator==(const SamplerKey& other) const {
+        return words == other.words;
+    }
+};
+
+struct SamplerKeyHash {
+    size_t operator()(const SamplerKey& key) const;
+};
+
+//////////////////////
+//
+// The cache
+//
+//////////////////////
+
+class SamplerCache {
+public:
+    void createSamplerCache(VulkanSetup* pVkSetup);
+
+    // returns the sampler created from samplerInfo, the same one for every acquire with the same configuration. Each
+    // acquire must be matched by a release
+    VkSampler acquireSampler(const VkSamplerCreateInfo& samplerInfo);
+
+    // destroys the sampler once every acquire of it has been released
+    void releaseSampler(VkSampler sampler);
+
+    // destroys the samplers that are still acquired
+    void cleanupSamplerCache();
+
+private:
+    static SamplerKey makeKey(const VkSamplerCreateInfo& samplerInfo);
+
+    // a POD struct containing a cached sampler and the number of acquires it has not been released from
+    struct CachedSampler {
+        VkSampler sampler;
+        uint32_t  refCount;
+    };
+
+public:
+    VulkanSetup* vkSetup;
+
+private:
+    std::unordered_map<SamplerKey, CachedSampler, SamplerKeyHash> samplers;
+    // the key of each sampler, for releasing by handle
+    std::unordered_map<VkSampler, SamplerKey> samplerKeys;
+};
+
+#endif // !SAMPLER_CACHE_H
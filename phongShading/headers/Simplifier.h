@@ -0,0 +1,41 @@
+//
+// A header file for the quadric error metric mesh simplifier used to generate the levels of detail of a model
+//
+
+#ifndef SIMPLIFIER_H
+#define SIMPLIFIER_H
+
+#include "Vertex.h" // vertex struct
+
+#include <stdint.h> // uint32_t
+
+#include <vector> // vector container
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// how much more the planes through the open borders of a mesh weigh than the planes of its triangles, keeps the
+// outline of open meshes in place
+const float SIMPLIFIER_BORDER_WEIGHT = 10.0f;
+
+//////////////////////
+//
+// Simplifier functions namespace
+//
+//////////////////////
+
+namespace simplifier {
+
+    // reduces the triangles of indices to at most targetIndexCount indices by collapsing edges (Garland & Heckbert 1997),
+    // cheapest first. Each collapse moves one end of the edge onto the other so the simplified triangles index the same
+    // vertices and can share the vertex buffer. Vertices at the same position with different attributes (uv seams) are
+    // collapsed together. Stops early if no more edges can be collapsed without flipping triangles. Returns the largest
+    // error introduced, a distance in model space
+    float simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+        std::vector<uint32_t>& output);
+}
+
+#endif // !SIMPLIFIER_H
@@ -0,0 +1,88 @@
+//
+// A persistently mapped staging buffer that loaders write their data straight into, rather than building it in a cpu
+// array that is then copied to a temporary staging buffer. Regions are handed out from large blocks of host visible
+// memory that stay mapped for the lifetime of the buffer
+//
+
+#ifndef STAGING_BUFFER_H
+#define STAGING_BUFFER_H
+
+#include "VulkanSetup.h" // for referencing the device
+
+#include <stdint.h> // uint8_t, uint32_t
+
+#include <mutex> // regions are allocated from the decoding threads
+#include <vector> // vector container
+
+#include <vulkan/vulkan_core.h>
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the size of the block that is kept for the lifetime of the staging buffer, larger regions get a block of their own
+// which is destroyed once the region is freed
+const VkDeviceSize STAGING_BLOCK_SIZE = 64 * 1024 * 1024;
+
+//////////////////////
+//
+// Staging regions
+//
+//////////////////////
+
+// a POD struct containing a region of the staging buffer, written by the cpu through data and copied from by the gpu
+// at offset in buffer
+struct StagingRegion {
+    VkBuffer     buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size   = 0;
+    uint8_t*     data   = nullptr;
+    // the block the region was allocated from, for freeing it
+    uint32_t     block  = 0;
+};
+
+class StagingBuffer {
+public:
+    // creates and maps the first block
+    void createStagingBuffer(VulkanSetup* pVkSetup);
+
+    // a region of size bytes at an offset that is a multiple of alignment. Can be called from any thread
+    StagingRegion allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+    // frees a region once the gpu is done copying from it. A block is reused once all its regions are freed. Can be
+    // called from any thread
+    void free(StagingRegion& region);
+
+    // unmaps and destroys the blocks, every region must have been freed
+    void cleanupStagingBuffer();
+
+private:
+    // a POD struct containing a mapped block of staging memory, regions are allocated one after the other
+    struct StagingBlock {
+        VkBuffer         buffer  = VK_NULL_HANDLE;
+        MemoryAllocation memory;
+        uint8_t*         mapped  = nullptr;
+        VkDeviceSize     size    = 0;
+        VkDeviceSize     used    = 0;
+        uint32_t         regions = 0;
+    };
+
+    void createBlock(VkDeviceSize size, StagingBlock& block);
+
+    void destroyBlock(StagingBlock& block);
+
+public:
+    VulkanSetup* vkSetup;
+
+private:
+    // host cached memory if the device has some, as the cpu mip chains read back the levels they write
+    VkMemoryPropertyFlags memoryProperties;
+
+    // the first block is kept, the others are destroyed when freed and their slot reused
+    std::vector<StagingBlock> blocks;
+    std::mutex mutex;
+};
+
+#endif // !STAGING_BUFFER_H
@@ -6,33 +6,149 @@
 #define TEXTURE_H
 
 #include <VulkanSetup.h>
+#include <SamplerCache.h> // shared samplers
+#include <StagingBuffer.h> // decoding straight into staging memory
+#include <UploadBatcher.h> // the uploads are recorded into the current batch
+#include <Ktx2.h> // compressed textures
 
 #include <string> // string class
+#include <vector> // copy regions
+#include <thread> // decoding thread
+#include <atomic> // decoding done flag
+#include <exception> // decoding error
 
 #include <vulkan/vulkan_core.h>
 
+// the alignment of the texture data in the staging buffer, a multiple of 4 bytes and of the largest texel block size
+// as required by the copies
+const VkDeviceSize TEXTURE_STAGING_ALIGNMENT = 16;
+
+// a POD struct containing a texture decoded on the cpu, ready to be copied to the device
+struct TextureData {
+    VkFormat                       format    = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t                       width     = 0;
+    uint32_t                       height    = 0;
+    uint32_t                       mipLevels = 1;
+    // the levels to copy, decoded straight into staging memory, with one copy region per level relative to the start
+    // of the staging region. The levels after the copied ones are blitted on the gpu
+    StagingRegion                  staging;
+    std::vector<VkBufferImageCopy> regions;
+    bool                           blitMipmaps = false;
+};
+
 class Texture {
 public:
-    void createTexture(VulkanSetup* pVkSetup, const std::string& path, const VkCommandPool& commandPool);
+    // the sampler is acquired from the cache and released on cleanup, the texture is decoded into the staging buffer
+    // and its upload recorded into the batch of the upload batcher, it can be drawn once the batch is submitted
+    void createTexture(VulkanSetup* pVkSetup, SamplerCache* pSamplerCache, StagingBuffer* pStagingBuffer, const std::string& path,
+        UploadBatcher* pUploadBatcher);
+
+    // binds a 1x1 white placeholder straight away and decodes the texture at path on a worker thread, updateStreaming
+    // then uploads it and swaps it in
+    void createTextureAsync(VulkanSetup* pVkSetup, SamplerCache* pSamplerCache, StagingBuffer* pStagingBuffer, const std::string& path,
+        UploadBatcher* pUploadBatcher);
+
+    // to be called every frame while streaming, on the thread submitting to the queues. Submits the upload once the
+    // texture is decoded and swaps the image in once the upload is done, without waiting on either. Returns true on the
+    // call that swaps the image view, the descriptors that use it must then be written again
+    bool updateStreaming();
 
     void cleanupTexture();
 
+    //
+    // Batched loading
+    //
+
+    // the first half of createTexture, decoding the image at path whose content is already read in fileContent. Only
+    // reads from the vulkan setup so that a batch of textures can be decoded concurrently
+    void decodeTexture(VulkanSetup* pVkSetup, SamplerCache* pSamplerCache, StagingBuffer* pStagingBuffer, const std::string& path,
+        const std::vector<uint8_t>& fileContent, TextureData& textureData);
+
+    // the second half, creates the image, its view and sampler and records the upload of textureData from its staging
+    // region into the current batch of pUploadBatcher, so that a batch of textures is uploaded with a single submit.
+    // The region is handed to the batch, which frees it once the upload is done
+    void recordBatchedUpload(TextureData& textureData, UploadBatcher* pUploadBatcher);
+
 private:
 
-    void createTextureImage(const std::string& path, const VkCommandPool& commandPool);
+    // fills textureData from the ktx2 file at path or the one next to the image at path if the device supports its
+    // format, otherwise decodes the image and builds its mip chain. The image is decoded from fileContent unless it is
+    // empty, in which case it is read from path. The texels are written straight into a region of the staging buffer.
+    // Only reads from the vulkan setup so it can run on a worker thread
+    void loadTextureData(const std::string& path, const std::vector<uint8_t>& fileContent, TextureData& textureData);
+
+    // true if the device can sample and filter images of the format, and copy to them
+    bool isFormatSupported(VkFormat format);
+
+    // fills in everything but the staging region, which the levels have been read into
+    void loadCompressedTextureData(const Ktx2Texture& compressed, TextureData& textureData);
+
+    void loadUncompressedTextureData(const std::string& path, const std::vector<uint8_t>& fileContent, TextureData& textureData);
+
+    // the copy of a whole level from the staging buffer
+    static VkBufferImageCopy levelCopyRegion(uint32_t level, uint32_t width, uint32_t height, VkDeviceSize bufferOffset);
 
+    // creates the image the texture data is uploaded to
+    void createTextureImage(const TextureData& textureData, VkImage& image, MemoryAllocation& imageMemory);
+
+    // records the copy of the staging region to the image and then blits the rest of the chain or hands every level to
+    // the fragment shader. The copy goes on the transfer queue and the rest on the graphics queue
+    static void recordTextureUpload(UploadBatcher* uploadBatcher, const TextureData& textureData, VkImage image);
+
+    // records the blits that fill each level from the one before, the first level must be in the transfer destination
+    // layout and every level is left ready to be sampled
+    static void recordMipmapBlits(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    // creates the image and records its upload into the current batch, which frees the staging region once it is done
+    void uploadTextureImage(TextureData& textureData);
+
+    // submits the upload of the streamed texture with the current batch and returns straight away
+    void submitStreamedUpload();
+
+    // acquires the sampler of the texture from the cache
     void createTextureSampler();
 
 public:
     VulkanSetup* vkSetup;
+    SamplerCache* samplerCache;
+    StagingBuffer* stagingBuffer;
+    UploadBatcher* uploadBatcher;
 
     // a texture
     VkImage textureImage;
     VkImageView textureImageView;
+    // rgba8 for decoded images, or the block compressed format of a ktx2 file
+    VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    // the number of levels of the mip chain, down to 1x1
+    uint32_t mipLevels = 1;
+
+    VkSampler textureSampler; // lets us sample from an image, here the texture, shared by the textures with the same sampling
+
+    MemoryAllocation textureImageMemory;
+
+private:
+    //
+    // Streaming
+    //
+
+    // set by the worker thread once streamedData is filled, or once it failed
+    std::thread decodeThread;
+    std::atomic<bool> decoded = false;
+    std::exception_ptr decodeError;
+    TextureData streamedData;
+
+    // in flight between the submit of the upload and its batch being done
+    bool decoding = false;
+    bool uploading = false;
+    VkImage streamedImage = VK_NULL_HANDLE;
+    MemoryAllocation streamedImageMemory;
+    uint64_t streamingUpload = 0;
 
-    VkSampler textureSampler; // lets us sample from an image, here the texture
-    
-    VkDeviceMemory textureImageMemory;
+    // the placeholder once the texture has replaced it, kept until cleanup as the descriptors of frames still in flight
+    // may use it
+    VkImage placeholderImage = VK_NULL_HANDLE;
+    VkImageView placeholderImageView = VK_NULL_HANDLE;
+    MemoryAllocation placeholderImageMemory;
 };
 
 #endif // !TEXTURE_H
@@ -0,0 +1,122 @@
+//
+// A registry of the loaded textures, keyed by the content of their image files so that images loaded several times,
+// from the same path or from copies, share a single device image, view and sampler
+//
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "Texture.h" // texture class
+#include "SamplerCache.h" // shared samplers
+
+#include <stdint.h> // uint32_t, uint64_t
+
+#include <memory> // unique_ptr, textures don't move
+#include <string> // string for texture path
+#include <unordered_map> // textures by content
+#include <vector> // batches of textures
+
+//////////////////////
+//
+// Cache key
+//
+//////////////////////
+
+// a POD struct containing the identity of an image file's content
+struct TextureKey {
+    uint64_t contentHash;
+    uint64_t size;
+
+    bool operator==(const TextureKey& other) const {
+        return contentHash == other.contentHash && size == other.size;
+    }
+};
+
+struct TextureKeyHash {
+    size_t operator()(const TextureKey& key) const {
+        return static_cast<size_t>(key.contentHash);
+    }
+};
+
+// a POD struct containing the timings of the last batch of textures loaded, in milliseconds
+struct TextureBatchStats {
+    // the paths in the batch, and the textures created for them. The others were already loaded or were the same image
+    // as another path of the batch
+    size_t textureCount  = 0;
+    size_t createdCount  = 0;
+    size_t uploadedBytes = 0;
+    // reading and hashing the files, on all cores
+    float  ioTime        = 0.0f;
+    // decoding the images or reading their ktx2 files and building the missing mip chains, on all cores
+    float  decodeTime    = 0.0f;
+    // creating the images and recording their uploads into the current batch. The copies themselves run on the gpu
+    // once the batch is submitted, after the loading phase has recorded the rest of its uploads
+    float  recordTime    = 0.0f;
+};
+
+//////////////////////
+//
+// The cache
+//
+//////////////////////
+
+class TextureCache {
+public:
+    // the textures are decoded into pStagingBuffer and their uploads recorded into the batches of pUploadBatcher
+    void createTextureCache(VulkanSetup* pVkSetup, StagingBuffer* pStagingBuffer, UploadBatcher* pUploadBatcher);
+
+    // returns the texture of the image at path, the same one for every image with the same content. A new texture is
+    // streamed in behind a placeholder or loaded straight away. Each acquire must be matched by a release
+    Texture* acquireTexture(const std::string& path, bool stream);
+
+    // acquires the textures of the images at paths at once, the files are read and decoded concurrently and the uploads
+    // of the new textures are recorded into the current batch, to be submitted with the rest of the loading phase. The
+    // timings of each stage are kept in batchStats
+    std::vector<Texture*> acquireTextures(const std::vector<std::string>& paths);
+
+    // destroys the texture once every acquire of it has been released
+    void releaseTexture(Texture* texture);
+
+    // streams in the textures still loading, returns true if any of them swapped its image view in which case the
+    // descriptors using it must be written again
+    bool updateStreaming();
+
+    // destroys the textures that are still acquired, and the samplers
+    void cleanupTextureCache();
+
+private:
+    // reads the whole file at path into content
+    static void readFile(const std::string& path, std::vector<uint8_t>& content);
+
+    // hashes the content of a file
+    static TextureKey makeKey(const std::vector<uint8_t>& content);
+
+    // a POD struct containing a cached texture and the number of acquires it has not been released from
+    struct CachedTexture {
+        std::unique_ptr<Texture> texture;
+        uint32_t                 refCount;
+        bool                     streaming;
+    };
+
+public:
+    VulkanSetup* vkSetup;
+
+    // the samplers of the textures, shared by the textures sampled the same way
+    SamplerCache samplerCache;
+
+    // the timings of the last call to acquireTextures
+    TextureBatchStats batchStats;
+
+private:
+    // the batches the uploads are recorded into
+    UploadBatcher* uploadBatcher;
+
+    // where the textures are decoded into
+    StagingBuffer* stagingBuffer;
+
+    std::unordered_map<TextureKey, CachedTexture, TextureKeyHash> textures;
+    // the key of each texture, for releasing by handle
+    std::unordered_map<Texture*, TextureKey> textureKeys;
+};
+
+#endif // !TEXTURE_CACHE_H
@@ -0,0 +1,31 @@
+//
+// A header file for cooking images offline into block compressed KTX2 textures with their full mip chain
+//
+
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <stdint.h> // uint32_t
+
+#include <string> // string for texture paths
+
+#include <vulkan/vulkan_core.h> // VkFormat
+
+//////////////////////
+//
+// Texture cooker functions namespace
+//
+//////////////////////
+
+namespace texturecooker {
+
+    // the sRGB BC format named bc1 or bc7, throws for any other name
+    VkFormat formatFromName(const std::string& name);
+
+    // decodes the image at sourcePath, builds its mip chain on the cpu and encodes every level into format with the
+    // given number of endpoint refinements, then writes the chain to a ktx2 file at outputPath. Prints the time taken by
+    // each stage, the encoding throughput in MPix/s and the PSNR of the whole chain against the uncompressed one
+    void cookTexture(const std::string& sourcePath, const std::string& outputPath, VkFormat format, uint32_t refinements);
+}
+
+#endif // !TEXTURE_COOKER_H
@@ -0,0 +1,54 @@
+//
+// A table of every texture in use, bound once as an array of combined image samplers. Each material holds the slot of
+// its texture so that draws with different textures share a descriptor set and can be batched in one indirect draw
+//
+
+#ifndef TEXTURE_TABLE_H
+#define TEXTURE_TABLE_H
+
+#include "VulkanSetup.h" // for referencing the device
+#include "Texture.h" // texture class
+
+#include <stdint.h> // uint32_t
+
+#include <unordered_map> // slots by texture
+#include <vector> // vector container
+
+#include <vulkan/vulkan_core.h>
+
+class TextureTable {
+public:
+    // the table has vkSetup->textureTableSize slots, all free
+    void createTextureTable(VulkanSetup* pVkSetup);
+
+    // returns the slot of texture, adding it to the first free slot if it isn't in the table yet. Each add must be
+    // matched by a remove. Throws if the table is full
+    uint32_t addTexture(Texture* texture);
+
+    // frees the slot of texture once every add of it has been removed
+    void removeTexture(Texture* texture);
+
+    // writes every slot of the table to the binding of set, with the current view and sampler of each texture. The
+    // free slots are written with the texture of the first used one as every element of the array must be valid, so
+    // the table must not be empty. The set must not be in use by a pending command buffer
+    void writeDescriptors(VkDescriptorSet set, uint32_t binding) const;
+
+    void cleanupTextureTable();
+
+private:
+    // a POD struct containing a slot of the table and the number of adds it has not been removed from
+    struct TableSlot {
+        Texture* texture  = nullptr;
+        uint32_t refCount = 0;
+    };
+
+public:
+    VulkanSetup* vkSetup;
+
+private:
+    std::vector<TableSlot> slots;
+    // the slot of each texture, for finding the slot of a texture already in the table
+    std::unordered_map<Texture*, uint32_t> textureSlots;
+};
+
+#endif // !TEXTURE_TABLE_H
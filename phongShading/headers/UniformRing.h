@@ -0,0 +1,71 @@
+//
+// A persistently mapped ring of uniform memory, one buffer split into slices that are each written by the cpu while
+// the gpu reads the others. Uniforms are bump allocated from the current slice and bound as dynamic uniform buffers,
+// so the descriptor sets never change and the offset of each allocation is given when the set is bound
+//
+
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include "VulkanSetup.h" // for referencing the device
+
+#include <stdint.h> // uint8_t, uint32_t
+
+#include <vulkan/vulkan_core.h>
+
+//////////////////////
+//
+// Constants
+//
+//////////////////////
+
+// the size of each slice, enough for the uniforms of every object drawn in a frame
+const VkDeviceSize UNIFORM_RING_SLICE_SIZE = 64 * 1024;
+
+//////////////////////
+//
+// Uniform allocations
+//
+//////////////////////
+
+// a POD struct containing uniforms of the current slice, written through data and bound with offset as the dynamic
+// offset of their descriptor
+struct UniformAllocation {
+    uint32_t offset = 0;
+    uint8_t* data   = nullptr;
+};
+
+class UniformRing {
+public:
+    // creates the buffer with room for sliceCount slices, in host coherent memory that stays mapped
+    void createUniformRing(VulkanSetup* pVkSetup, uint32_t sliceCount);
+
+    // starts allocating from the start of slice, the gpu must be done reading the uniforms previously written to it
+    void beginSlice(uint32_t slice);
+
+    // size bytes of the current slice, aligned to the device's minimum uniform buffer offset alignment
+    UniformAllocation allocate(VkDeviceSize size);
+
+    // the offset of the first allocation of slice
+    uint32_t sliceOffset(uint32_t slice) const;
+
+    void cleanupUniformRing();
+
+public:
+    VulkanSetup* vkSetup;
+
+    // the one buffer bound by the dynamic uniform descriptors
+    VkBuffer buffer;
+    MemoryAllocation bufferMemory;
+
+private:
+    VkDeviceSize alignment;
+    uint32_t sliceCount;
+
+    // the start and end of the current slice and the next free byte in it
+    VkDeviceSize sliceStart;
+    VkDeviceSize sliceEnd;
+    VkDeviceSize head;
+};
+
+#endif // !UNIFORM_RING_H
@@ -0,0 +1,109 @@
+//
+// Records the copies and barriers of a loading phase into a single command buffer that is submitted once with a fence,
+// rather than submitting and waiting for the queue to be idle after each of them. The staging regions the copies read
+// from are handed to the batch and freed once its fence is signaled, which callers poll with the ticket of the batch.
+// When the device has a transfer queue the copies are submitted to it, so they run alongside the rendering. The
+// resources they write are handed over to the graphics queue by a second submit, made once the copies are done so
+// that the graphics queue never waits for them
+//
+
+#ifndef UPLOAD_BATCHER_H
+#define UPLOAD_BATCHER_H
+
+#include "VulkanSetup.h" // for referencing the device
+#include "StagingBuffer.h" // the regions the uploads read from
+
+#include <stdint.h> // uint64_t
+
+#include <vector> // vector container
+
+#include <vulkan/vulkan_core.h>
+
+class UploadBatcher {
+public:
+    // the graphics command buffers of the batches are allocated from commandPool, the staging regions are freed to
+    // pStagingBuffer. The transfer command buffers get a pool of their own
+    void createUploadBatcher(VulkanSetup* pVkSetup, StagingBuffer* pStagingBuffer, const VkCommandPool& commandPool);
+
+    // the command buffer the copies of the batch being recorded go in, only copies and barriers with transfer stages can
+    // be recorded into it. It is the graphics command buffer when there is no transfer queue
+    VkCommandBuffer recordTransfer();
+
+    // the command buffer of the batch that runs on the graphics queue once the copies are done, for the blits and the
+    // barriers to the shader stages. Both are begun on first use after a submit
+    VkCommandBuffer recordGraphics();
+
+    // hands a range of a buffer written by the copies to the graphics queue, where it is next accessed with dstAccess
+    // in dstStage. Nothing to do without a transfer queue, the batch ends with a barrier for every buffer
+    void transferBufferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+    // hands an image written by the copies to the graphics queue, transitioning it from oldLayout to newLayout. Without
+    // a transfer queue this is a plain barrier after the copies
+    void transferImageOwnership(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+    // the batch being recorded reads from region, which is freed once the batch is done. The region is reset so that the
+    // caller doesn't free it
+    void freeAfterUpload(StagingRegion& region);
+
+    // submits the batch being recorded, if any, and returns its ticket. The batch ends with a barrier making its copies
+    // visible to the vertex input and the shaders of the commands submitted after it to the graphics queue. With a
+    // transfer queue that part of the batch is only submitted by update() once the copies are done, what the batch
+    // writes can't be used before its ticket is complete
+    uint64_t submit();
+
+    // submits the graphics part of the batches whose copies are done, and frees the staging regions and command buffers
+    // of the batches that are complete, without waiting. Called once per frame
+    void update();
+
+    // true once the batch with ticket is done, polls its fence
+    bool isComplete(uint64_t ticket);
+
+    // submits the batch with ticket if it is still being recorded and waits for it
+    void wait(uint64_t ticket);
+
+    // submits and waits for every batch, then frees them
+    void cleanupUploadBatcher();
+
+private:
+    // a POD struct containing a batch of uploads, recorded into a command buffer per queue and in flight until its fence
+    // is signaled. The graphics command buffer is submitted once the transfer fence is signaled
+    struct UploadBatch {
+        uint64_t                   ticket                = 0;
+        VkCommandBuffer            transferCommandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer            commandBuffer         = VK_NULL_HANDLE;
+        VkFence                    transferFence         = VK_NULL_HANDLE;
+        VkFence                    fence                 = VK_NULL_HANDLE;
+        bool                       graphicsSubmitted     = false;
+        std::vector<StagingRegion> stagingRegions;
+    };
+
+    // true if the copies are submitted to a queue of another family than the graphics queue
+    bool hasTransferQueue() const;
+
+    // submits the graphics command buffer of the batch, which signals its fence
+    void submitGraphics(UploadBatch& batch);
+
+    // waits for the copies of the batch and submits its graphics part if it isn't yet, then waits for the whole batch
+    void waitForBatch(UploadBatch& batch);
+
+    // frees what the batch used once its fence is signaled
+    void retireBatch(UploadBatch& batch);
+
+public:
+    VulkanSetup* vkSetup;
+
+private:
+    StagingBuffer* stagingBuffer;
+    VkCommandPool commandPool;
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+    // the batch being recorded, its command buffers are null until something is recorded
+    UploadBatch recording;
+    // the submitted batches, in submit order
+    std::vector<UploadBatch> pending;
+    // the ticket of the next batch
+    uint64_t nextTicket = 1;
+};
+
+#endif // !UPLOAD_BATCHER_H
@@ -17,6 +17,8 @@
 
 #include <vulkan/vulkan_core.h> // vulkan core structs &c
 
+#include "MemoryAllocator.h" // buffers and images are sub-allocated
+
 // vectors, matrices ...
 #include <glm/glm.hpp>
 
@@ -41,6 +43,8 @@ const std::string TEXTURE_PATH = "C:\\Users\\Tommy\\Documents\\COMP4\\5822HighPe
 // paths to the fragment and vertex shaders used
 const std::string SHADER_VERT_PATH = "C:\\Users\\Tommy\\Documents\\COMP4\\5822HighPerformanceGraphics\\A1\\HPGA1VulkanTutorial\\phongShading\\source\\shaders\\vert.spv";
 const std::string SHADER_FRAG_PATH = "C:\\Users\\Tommy\\Documents\\COMP4\\5822HighPerformanceGraphics\\A1\\HPGA1VulkanTutorial\\phongShading\\source\\shaders\\frag.spv";
+// vertex shader decoding the packed vertex format
+const std::string SHADER_VERT_PACKED_PATH = "C:\\Users\\Tommy\\Documents\\COMP4\\5822HighPerformanceGraphics\\A1\\HPGA1VulkanTutorial\\phongShading\\source\\shaders\\vertPacked.spv";
 
 // validation layers for debugging
 const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
@@ -56,6 +60,9 @@ const size_t MAX_FRAMES_IN_FLIGHT = 2;
 // the ImGUI number of descriptor pools
 const uint32_t IMGUI_POOL_NUM = 1000;
 
+// the most textures bound at once in the texture table, fewer if the device can't sample as many from one shader stage
+const uint32_t TEXTURE_TABLE_MAX_SIZE = 256;
+
 const glm::vec3 LIGHT_POS(0.0f, -30.0f, 50.0f);
 
 //////////////////////
@@ -78,6 +85,65 @@ const bool enableVerboseValidation = true;
 const bool enableVerboseValidation = false;
 #endif
 
+//////////////////////
+//
+// Vertex format preprocessor
+//
+//////////////////////
+
+//#define FULL_VERTICES // uncomment to upload the 20 byte VertexAttributes instead of the 8 byte PackedVertexAttributes
+#ifdef FULL_VERTICES
+const bool usePackedVertices = false;
+#else
+const bool usePackedVertices = true;
+#endif
+
+//////////////////////
+//
+// Model loading preprocessor
+//
+//////////////////////
+
+//#define RECOMPUTE_NORMALS // uncomment to replace the normals of the model with generated smooth ones
+#ifdef RECOMPUTE_NORMALS
+const bool recomputeModelNormals = true;
+#else
+const bool recomputeModelNormals = false;
+#endif
+
+//////////////////////
+//
+// Texture loading preprocessor
+//
+//////////////////////
+
+//#define UNCOMPRESSED_TEXTURES // uncomment to always decode the image rather than use a BC compressed .ktx2 next to it
+#ifdef UNCOMPRESSED_TEXTURES
+const bool useCompressedTextures = false;
+#else
+const bool useCompressedTextures = true;
+#endif
+
+//#define SYNCHRONOUS_TEXTURES // uncomment to load textures before the first frame rather than streaming them in
+#ifdef SYNCHRONOUS_TEXTURES
+const bool streamTextures = false;
+#else
+const bool streamTextures = true;
+#endif
+
+//////////////////////
+//
+// Upload preprocessor
+//
+//////////////////////
+
+//#define GRAPHICS_QUEUE_UPLOADS // uncomment to copy the uploads on the graphics queue even if there is a transfer queue
+#ifdef GRAPHICS_QUEUE_UPLOADS
+const bool useTransferQueue = false;
+#else
+const bool useTransferQueue = true;
+#endif
+
 //////////////////////
 //
 // Utility structs
@@ -90,6 +156,9 @@ struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     // presentation of image to vulkan surface handled by the device
     std::optional<uint32_t> presentFamily;
+    // a family that copies but doesn't draw, usually the dma engine of a discrete gpu. Uploads submitted to it run
+    // alongside the rendering. Not needed for the device to be suitable
+    std::optional<uint32_t> transferFamily;
 
     // returns true if the device supports the drawing commands AND the image can be presented to the surface
     inline bool isComplete() {
@@ -110,12 +179,13 @@ struct SwapChainSupportDetails {
 struct CreateImageData {
     uint32_t              width       = 0;
     uint32_t              height      = 0;
+    uint32_t              mipLevels   = 1;
     VkFormat              format      = VK_FORMAT_UNDEFINED;
     VkImageTiling         tiling      = VK_IMAGE_TILING_OPTIMAL;
     VkImageUsageFlags     usage       = VK_NULL_HANDLE;
     VkMemoryPropertyFlags properties  = VK_NULL_HANDLE;
     VkImage*              image       = nullptr;
-    VkDeviceMemory*       imageMemory = nullptr;
+    MemoryAllocation*     imageMemory = nullptr;
 };
 
 // a POD struct containing the data for transitioning from one image layout to another
@@ -153,9 +223,10 @@ namespace utils {
     // Image and image view creation
     //
 
-    void createImage(const VkDevice* device, const VkPhysicalDevice* physicalDevice, const CreateImageData& info);
+    // the memory of the image is sub-allocated from a block of the allocator
+    void createImage(const VkDevice* device, MemoryAllocator* allocator, const CreateImageData& info);
 
-    VkImageView createImageView(const VkDevice* device, const VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags);
+    VkImageView createImageView(const VkDevice* device, const VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
 
     //
     // Transitioning between image layouyts
@@ -166,15 +237,12 @@ namespace utils {
     void transitionImageLayout(const VkDevice* device, const VkQueue* graphicsQueue, const TransitionImageLayoutData& transitionData);
 
     //
-    // Creating and copying buffers
+    // Creating buffers
     //
 
-    void copyBufferToImage(const VkDevice* device, const VkQueue* queue, const VkCommandPool& renderCommandPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-
-    void createBuffer(const VkDevice* device, const VkPhysicalDevice* physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-        VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-
-    void copyBuffer(const VkDevice* device, const VkQueue* queue, const VkCommandPool& commandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    // the memory of the buffer is sub-allocated from a block of the allocator, and mapped if it is host visible
+    void createBuffer(const VkDevice* device, MemoryAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkBuffer& buffer, MemoryAllocation& bufferMemory);
 }
 
 #endif // !UTILS_H
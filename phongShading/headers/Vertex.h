@@ -2,12 +2,15 @@
 #define VERTEX_H
 
 #include <array> // array container
+#include <cmath> // fabsf
 
 #include <glm/glm.hpp> // shader vectors, matrices ...
+#include <glm/gtc/packing.hpp> // half float and normalised integer packing
 
 #include <vulkan/vulkan_core.h>
 
-// a simple vertex struct
+// a simple vertex struct, used on the cpu only. It is split into the streams below for the vertex buffer. The material
+// is not a vertex attribute, each draw reads its own from the model's material table
 
 struct Vertex {
 
@@ -15,47 +18,150 @@ struct Vertex {
     glm::vec3 pos; 
     // normal
     glm::vec3 normal; 
-    // material properties
-    glm::vec4 material; 
     // texture coordinate
     glm::vec2 texCoord; 
+};
+
+// the vertex buffer holds two streams: the positions alone, tightly packed on binding 0, and the other attributes on
+// binding 1. Passes that only need the depth (prepass, shadow maps) bind the first stream and fetch 12 bytes per vertex
+
+const uint32_t POSITION_BINDING  = 0;
+const uint32_t ATTRIBUTE_BINDING = 1;
+
+// the position stream
+
+struct VertexPosition {
+
+    // position
+    glm::vec3 pos;
 
 
-    // binding description of a vertex
+    static VertexPosition fromVertex(const Vertex& vertex) {
+        return { vertex.pos };
+    }
+
+    // binding description of the position stream
     static VkVertexInputBindingDescription getBindingDescription() {
         // a struct containing info on how to store vertex data
         VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0; // index of binding in array of bindings
-        bindingDescription.stride = sizeof(Vertex); // bytes in one entry
+        bindingDescription.binding = POSITION_BINDING; // index of binding in array of bindings
+        bindingDescription.stride = sizeof(VertexPosition); // bytes in one entry
         bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; // how to move the next data
         // other option for instancing -> VK_VERTEX_INPUT_RATE_INSTANCE
         return bindingDescription;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
-        // we have two attributes: position and colour. The struct describes how to extract an attribute
-        // from a chunk of vertex data from a binding description
-        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+    // the only attribute a depth only pipeline needs
+    static VkVertexInputAttributeDescription getAttributeDescription() {
+        // the struct describes how to extract an attribute from a chunk of vertex data from a binding description
+        VkVertexInputAttributeDescription attributeDescription{};
         // position (vec3)
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
+        attributeDescription.binding = POSITION_BINDING;
+        attributeDescription.location = 0;
+        attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescription.offset = offsetof(VertexPosition, pos);
+        return attributeDescription;
+    }
+};
+
+// the attribute stream at full precision, 20 bytes
+
+struct VertexAttributes {
+
+    // normal
+    glm::vec3 normal;
+    // texture coordinate
+    glm::vec2 texCoord;
+
+
+    static VertexAttributes fromVertex(const Vertex& vertex) {
+        return { vertex.normal, vertex.texCoord };
+    }
+
+    // binding description of the attribute stream
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = ATTRIBUTE_BINDING;
+        bindingDescription.stride = sizeof(VertexAttributes);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        // locations follow on from the position's, location 2 used to be the material
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
         // normal (vec3)
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, normal);
-        // material (vec4)
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, material);
+        attributeDescriptions[0].binding = ATTRIBUTE_BINDING;
+        attributeDescriptions[0].location = 1;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(VertexAttributes, normal);
         // tex coord (vec2)
-        attributeDescriptions[3].binding = 0;
-        attributeDescriptions[3].location = 3;
-        attributeDescriptions[3].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[3].offset = offsetof(Vertex, texCoord);
+        attributeDescriptions[1].binding = ATTRIBUTE_BINDING;
+        attributeDescriptions[1].location = 3;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(VertexAttributes, texCoord);
+        return attributeDescriptions;
+    }
+};
+
+// a compact version of the attribute stream, 8 bytes instead of 20 (20 bytes per vertex with the position instead of
+// 32). The normal is octahedral encoded into two 16 bit snorms and the texture coordinate is stored as two half
+// floats. Decoded in shaderPacked.vert
+
+struct PackedVertexAttributes {
+
+    // octahedral normal (2 x snorm16)
+    uint32_t normal;
+    // texture coordinate (2 x float16)
+    uint32_t texCoord;
+
+
+    // packs the attributes of a full precision vertex
+    static PackedVertexAttributes pack(const Vertex& vertex) {
+        PackedVertexAttributes packed{};
+        packed.normal = glm::packSnorm2x16(octahedralEncode(vertex.normal));
+        packed.texCoord = glm::packHalf2x16(vertex.texCoord);
+        return packed;
+    }
+
+    // maps a unit vector onto the octahedron |x| + |y| + |z| = 1, then unfolds the lower half over the upper half 
+    // so that the whole sphere is covered by the square [-1, 1]^2
+    static glm::vec2 octahedralEncode(const glm::vec3& normal) {
+        float norm = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+        if (norm == 0.0f) {
+            return glm::vec2(0.0f, 0.0f);
+        }
+        glm::vec2 octahedron = glm::vec2(normal.x, normal.y) / norm;
+        if (normal.z < 0.0f) {
+            octahedron = glm::vec2(
+                (1.0f - fabsf(octahedron.y)) * (octahedron.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - fabsf(octahedron.x)) * (octahedron.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return octahedron;
+    }
+
+    // binding description of the packed attribute stream
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = ATTRIBUTE_BINDING;
+        bindingDescription.stride = sizeof(PackedVertexAttributes);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        // same locations as the full attributes. The formats do the first step of the decoding
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        // octahedral normal (snorm16 x 2 -> vec2 in [-1, 1])
+        attributeDescriptions[0].binding = ATTRIBUTE_BINDING;
+        attributeDescriptions[0].location = 1;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[0].offset = offsetof(PackedVertexAttributes, normal);
+        // tex coord (float16 x 2 -> vec2)
+        attributeDescriptions[1].binding = ATTRIBUTE_BINDING;
+        attributeDescriptions[1].location = 3;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(PackedVertexAttributes, texCoord);
         return attributeDescriptions;
     }
 };
@@ -155,6 +155,21 @@ public:
     VkQueue          graphicsQueue;
     // queue handle for interacting with the presentation queue
     VkQueue          presentQueue;
+    // the queue the uploads are copied on, a queue of a dedicated transfer family if the device has one and otherwise
+    // the graphics queue. The families differ only when there is a dedicated one
+    VkQueue          transferQueue;
+    uint32_t         graphicsFamily = 0;
+    uint32_t         transferFamily = 0;
+    // the properties and limits of the physical device
+    VkPhysicalDeviceProperties deviceProperties;
+    // the number of draws a single indirect draw command can issue, 1 without the multiDrawIndirect feature
+    uint32_t         maxDrawIndirectCount = 1;
+    // whether the BC1 to BC7 formats can be sampled
+    bool             textureCompressionBC = false;
+    // the number of textures in the texture table the fragment shader indexes
+    uint32_t         textureTableSize = 1;
+    // every buffer and image is sub-allocated from the blocks of device memory it holds
+    MemoryAllocator  memoryAllocator;
 
     //
     // Setup flag
@@ -0,0 +1,560 @@
+//
+// Definition of the BC1 and BC7 encoding and decoding
+//
+
+#include <BlockCompression.h>
+
+#include <Ktx2.h> // block size
+#include <Parallel.h> // parallelFor
+
+#include <algorithm> // min, max, swap
+#include <cfloat> // FLT_MAX
+#include <cmath> // sqrtf, fabsf, lroundf
+#include <cstring> // memset
+#include <stdexcept> // runtime_error
+
+// SSE2 is always there on x64, and on x86 when the compiler targets it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_USE_SSE
+#endif
+
+// the texels of a block as floats in [0, 255], the channels that aren't encoded are zero
+typedef float BlockTexels[16][4];
+
+// the interpolation weights of the 4 bit indices of BC7, out of 64
+static const uint8_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//////////////////////
+//
+// Endpoint fitting
+//
+//////////////////////
+
+// the endpoints at the extremes of the projection of the texels on their principal axis
+static void fitPrincipalEndpoints(const BlockTexels& texels, uint32_t channels, float endpoint0[4], float endpoint1[4]) {
+    float mean[4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            mean[c] += texels[t][c] / 16.0f;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t i = 0; i < channels; i++) {
+            for (uint32_t j = 0; j < channels; j++) {
+                covariance[i][j] += (texels[t][i] - mean[i]) * (texels[t][j] - mean[j]);
+            }
+        }
+    }
+
+    // the principal axis by power iteration, starting from the diagonal which is rarely orthogonal to it
+    float axis[4] = {};
+    for (uint32_t c = 0; c < channels; c++) {
+        axis[c] = 1.0f;
+    }
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float largest = 0.0f;
+        for (uint32_t i = 0; i < channels; i++) {
+            for (uint32_t j = 0; j < channels; j++) {
+                next[i] += covariance[i][j] * axis[j];
+            }
+            largest = std::max(largest, fabsf(next[i]));
+        }
+        // a block of a single colour
+        if (largest < 1e-6f) {
+            for (uint32_t c = 0; c < 4; c++) {
+                endpoint0[c] = endpoint1[c] = mean[c];
+            }
+            return;
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            axis[c] = next[c] / largest;
+        }
+    }
+    float length = 0.0f;
+    for (uint32_t c = 0; c < channels; c++) {
+        length += axis[c] * axis[c];
+    }
+    length = sqrtf(length);
+
+    float minimum = FLT_MAX, maximum = -FLT_MAX;
+    for (uint32_t t = 0; t < 16; t++) {
+        float projection = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            projection += (texels[t][c] - mean[c]) * axis[c] / length;
+        }
+        minimum = std::min(minimum, projection);
+        maximum = std::max(maximum, projection);
+    }
+
+    for (uint32_t c = 0; c < 4; c++) {
+        endpoint0[c] = std::clamp(mean[c] + axis[c] / length * minimum, 0.0f, 255.0f);
+        endpoint1[c] = std::clamp(mean[c] + axis[c] / length * maximum, 0.0f, 255.0f);
+    }
+}
+
+// the endpoints that minimise the squared error of the block for the weights of endpoint1 in [0, 1] of its texels,
+// returns false if they can't be solved for, when all the texels have the same weight
+static bool refineEndpoints(const BlockTexels& texels, const float weights[16], uint32_t channels, float endpoint0[4], float endpoint1[4]) {
+    // the normal equations of the least squares problem, shared by the channels
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x0[4] = {}, x1[4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        float w = weights[t];
+        a += (1.0f - w) * (1.0f - w);
+        b += (1.0f - w) * w;
+        c += w * w;
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            x0[channel] += (1.0f - w) * texels[t][channel];
+            x1[channel] += w * texels[t][channel];
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if (fabsf(determinant) < 1e-6f) {
+        return false;
+    }
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        endpoint0[channel] = std::clamp((c * x0[channel] - b * x1[channel]) / determinant, 0.0f, 255.0f);
+        endpoint1[channel] = std::clamp((a * x1[channel] - b * x0[channel]) / determinant, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+//////////////////////
+//
+// Index selection
+//
+//////////////////////
+
+// finds the closest palette entry to each texel and returns the squared error of the block. The palette has 4 or 16
+// entries, with the channels that aren't encoded at zero like the texels
+static float selectIndices(const BlockTexels& texels, const float palette[16][4], uint32_t paletteSize, uint8_t indices[16]) {
+    float error = 0.0f;
+#ifdef BC_USE_SSE
+    // the palette transposed, each register holds a channel of 4 entries
+    uint32_t groups = paletteSize / 4;
+    __m128 entries[4][4];
+    __m128 entryIndices[4];
+    for (uint32_t g = 0; g < groups; g++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            entries[g][c] = _mm_setr_ps(palette[4 * g + 0][c], palette[4 * g + 1][c], palette[4 * g + 2][c], palette[4 * g + 3][c]);
+        }
+        entryIndices[g] = _mm_setr_ps((float)(4 * g + 0), (float)(4 * g + 1), (float)(4 * g + 2), (float)(4 * g + 3));
+    }
+
+    for (uint32_t t = 0; t < 16; t++) {
+        // the distances to 4 entries at a time, each lane keeping the closest of the entries it has seen
+        __m128 bestError = _mm_set1_ps(FLT_MAX);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (uint32_t g = 0; g < groups; g++) {
+            __m128 distance = _mm_setzero_ps();
+            for (uint32_t c = 0; c < 4; c++) {
+                __m128 difference = _mm_sub_ps(entries[g][c], _mm_set1_ps(texels[t][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+            }
+            __m128 closer = _mm_cmplt_ps(distance, bestError);
+            bestError = _mm_min_ps(distance, bestError);
+            bestIndex = _mm_or_ps(_mm_and_ps(closer, entryIndices[g]), _mm_andnot_ps(closer, bestIndex));
+        }
+
+        // then the closest of the lanes
+        alignas(16) float errors[4];
+        alignas(16) float lanes[4];
+        _mm_store_ps(errors, bestError);
+        _mm_store_ps(lanes, bestIndex);
+        uint32_t lane = 0;
+        for (uint32_t l = 1; l < 4; l++) {
+            if (errors[l] < errors[lane]) {
+                lane = l;
+            }
+        }
+        indices[t] = static_cast<uint8_t>(lanes[lane]);
+        error += errors[lane];
+    }
+#else
+    for (uint32_t t = 0; t < 16; t++) {
+        float bestError = FLT_MAX;
+        for (uint32_t i = 0; i < paletteSize; i++) {
+            float distance = 0.0f;
+            for (uint32_t c = 0; c < 4; c++) {
+                float difference = palette[i][c] - texels[t][c];
+                distance += difference * difference;
+            }
+            if (distance < bestError) {
+                bestError = distance;
+                indices[t] = static_cast<uint8_t>(i);
+            }
+        }
+        error += bestError;
+    }
+#endif
+    return error;
+}
+
+//////////////////////
+//
+// BC1
+//
+//////////////////////
+
+static uint16_t packColour565(const float colour[4]) {
+    uint32_t r = static_cast<uint32_t>(lroundf(colour[0] * 31.0f / 255.0f));
+    uint32_t g = static_cast<uint32_t>(lroundf(colour[1] * 63.0f / 255.0f));
+    uint32_t b = static_cast<uint32_t>(lroundf(colour[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// the four entries of the palette of a block in rgba8, as the decoder computes them
+static void bc1Palette(uint16_t colour0, uint16_t colour1, uint8_t palette[4][4]) {
+    for (uint32_t e = 0; e < 2; e++) {
+        uint16_t packed = e == 0 ? colour0 : colour1;
+        uint32_t r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        // replicate the high bits in the low ones so that 0 and the maximum map to 0 and 255
+        palette[e][0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+        palette[e][1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+        palette[e][2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+        palette[e][3] = 255;
+    }
+    for (uint32_t c = 0; c < 3; c++) {
+        // four colours when the first endpoint is the larger one, otherwise three and transparent black
+        if (colour0 > colour1) {
+            palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+            palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+        }
+        else {
+            palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c] + 1) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = colour0 > colour1 ? 255 : 0;
+}
+
+void blockcompression::encodeBC1Block(const uint8_t texels[64], uint32_t refinements, uint8_t block[8]) {
+    BlockTexels blockTexels = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            blockTexels[t][c] = texels[4 * t + c];
+        }
+    }
+
+    float endpoint0[4], endpoint1[4];
+    fitPrincipalEndpoints(blockTexels, 3, endpoint0, endpoint1);
+
+    uint16_t bestColour0 = 0, bestColour1 = 0;
+    uint8_t bestIndices[16] = {};
+    float bestError = FLT_MAX;
+    for (uint32_t pass = 0; pass <= refinements; pass++) {
+        // the larger endpoint first for the four colour mode, if they are equal the block is decoded in the three
+        // colour mode and its palette is used as is
+        uint16_t colour0 = packColour565(endpoint0);
+        uint16_t colour1 = packColour565(endpoint1);
+        if (colour0 < colour1) {
+            std::swap(colour0, colour1);
+            std::swap(endpoint0, endpoint1);
+        }
+
+        uint8_t palette[4][4];
+        bc1Palette(colour0, colour1, palette);
+        float floatPalette[16][4] = {};
+        for (uint32_t e = 0; e < 4; e++) {
+            for (uint32_t c = 0; c < 3; c++) {
+                floatPalette[e][c] = palette[e][c];
+            }
+        }
+
+        uint8_t indices[16];
+        float error = selectIndices(blockTexels, floatPalette, 4, indices);
+        if (error < bestError) {
+            bestError = error;
+            bestColour0 = colour0;
+            bestColour1 = colour1;
+            std::copy(indices, indices + 16, bestIndices);
+        }
+
+        // the next endpoints from the indices, in the four colour mode the entries are at 0, 1, 1/3 and 2/3
+        if (pass == refinements || colour0 == colour1) {
+            break;
+        }
+        const float entryWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        float weights[16];
+        for (uint32_t t = 0; t < 16; t++) {
+            weights[t] = entryWeights[indices[t]];
+        }
+        if (!refineEndpoints(blockTexels, weights, 3, endpoint0, endpoint1)) {
+            break;
+        }
+    }
+
+    // little endian endpoints then 2 bits per texel from the first
+    block[0] = static_cast<uint8_t>(bestColour0 & 0xFF);
+    block[1] = static_cast<uint8_t>(bestColour0 >> 8);
+    block[2] = static_cast<uint8_t>(bestColour1 & 0xFF);
+    block[3] = static_cast<uint8_t>(bestColour1 >> 8);
+    for (uint32_t row = 0; row < 4; row++) {
+        block[4 + row] = static_cast<uint8_t>(bestIndices[4 * row] | (bestIndices[4 * row + 1] << 2) | (bestIndices[4 * row + 2] << 4) | (bestIndices[4 * row + 3] << 6));
+    }
+}
+
+void blockcompression::decodeBC1Block(const uint8_t block[8], uint8_t texels[64]) {
+    uint16_t colour0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    uint16_t colour1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    uint8_t palette[4][4];
+    bc1Palette(colour0, colour1, palette);
+
+    for (uint32_t t = 0; t < 16; t++) {
+        uint32_t index = (block[4 + t / 4] >> (2 * (t % 4))) & 3;
+        for (uint32_t c = 0; c < 4; c++) {
+            texels[4 * t + c] = palette[index][c];
+        }
+    }
+}
+
+//////////////////////
+//
+// BC7
+//
+//////////////////////
+
+// the bits of a BC7 block are packed from the lowest bit of the first byte
+static void writeBits(uint8_t block[16], uint32_t& offset, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, offset++) {
+        if ((value >> i) & 1) {
+            block[offset >> 3] |= static_cast<uint8_t>(1 << (offset & 7));
+        }
+    }
+}
+
+static uint32_t readBits(const uint8_t block[16], uint32_t& offset, uint32_t count) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++, offset++) {
+        value |= ((block[offset >> 3] >> (offset & 7)) & 1u) << i;
+    }
+    return value;
+}
+
+// the 7 bit endpoint and shared low bit closest to an rgba endpoint, mode 6 endpoints are 8 bits with the low bit of all
+// four channels in common
+static void quantiseEndpointMode6(const float endpoint[4], uint8_t quantised[4], uint8_t& pBit) {
+    float bestError = FLT_MAX;
+    for (uint8_t p = 0; p < 2; p++) {
+        uint8_t candidate[4];
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            long value = std::clamp(lroundf((endpoint[c] - p) / 2.0f), 0L, 127L);
+            candidate[c] = static_cast<uint8_t>(value);
+            float difference = static_cast<float>((value << 1) | p) - endpoint[c];
+            error += difference * difference;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            std::copy(candidate, candidate + 4, quantised);
+        }
+    }
+}
+
+// the sixteen entries of the palette of a mode 6 block in rgba8
+static void bc7Palette(const uint8_t endpoint0[4], const uint8_t endpoint1[4], uint8_t palette[16][4]) {
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            palette[i][c] = static_cast<uint8_t>(((64 - BC7_WEIGHTS[i]) * endpoint0[c] + BC7_WEIGHTS[i] * endpoint1[c] + 32) >> 6);
+        }
+    }
+}
+
+void blockcompression::encodeBC7Block(const uint8_t texels[64], uint32_t refinements, uint8_t block[16]) {
+    BlockTexels blockTexels;
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            blockTexels[t][c] = texels[4 * t + c];
+        }
+    }
+
+    float endpoint0[4], endpoint1[4];
+    fitPrincipalEndpoints(blockTexels, 4, endpoint0, endpoint1);
+
+    uint8_t bestQuantised[2][4] = {};
+    uint8_t bestPBits[2] = {};
+    uint8_t bestIndices[16] = {};
+    float bestError = FLT_MAX;
+    for (uint32_t pass = 0; pass <= refinements; pass++) {
+        uint8_t quantised[2][4];
+        uint8_t pBits[2];
+        quantiseEndpointMode6(endpoint0, quantised[0], pBits[0]);
+        quantiseEndpointMode6(endpoint1, quantised[1], pBits[1]);
+
+        uint8_t expanded[2][4];
+        for (uint32_t e = 0; e < 2; e++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                expanded[e][c] = static_cast<uint8_t>((quantised[e][c] << 1) | pBits[e]);
+            }
+        }
+        uint8_t palette[16][4];
+        bc7Palette(expanded[0], expanded[1], palette);
+        float floatPalette[16][4];
+        for (uint32_t i = 0; i < 16; i++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                floatPalette[i][c] = palette[i][c];
+            }
+        }
+
+        uint8_t indices[16];
+        float error = selectIndices(blockTexels, floatPalette, 16, indices);
+        if (error < bestError) {
+            bestError = error;
+            std::copy(&quantised[0][0], &quantised[0][0] + 8, &bestQuantised[0][0]);
+            std::copy(pBits, pBits + 2, bestPBits);
+            std::copy(indices, indices + 16, bestIndices);
+        }
+
+        if (pass == refinements) {
+            break;
+        }
+        float weights[16];
+        for (uint32_t t = 0; t < 16; t++) {
+            weights[t] = BC7_WEIGHTS[indices[t]] / 64.0f;
+        }
+        if (!refineEndpoints(blockTexels, weights, 4, endpoint0, endpoint1)) {
+            break;
+        }
+    }
+
+    // the first index is stored without its high bit, which must be 0, swapping the endpoints flips the indices
+    if (bestIndices[0] >= 8) {
+        std::swap(bestQuantised[0], bestQuantised[1]);
+        std::swap(bestPBits[0], bestPBits[1]);
+        for (uint32_t t = 0; t < 16; t++) {
+            bestIndices[t] = static_cast<uint8_t>(15 - bestIndices[t]);
+        }
+    }
+
+    // mode 6 is 6 zero bits then a one, the endpoints channel by channel, the two p bits and the indices
+    memset(block, 0, 16);
+    uint32_t offset = 0;
+    writeBits(block, offset, 1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        writeBits(block, offset, bestQuantised[0][c], 7);
+        writeBits(block, offset, bestQuantised[1][c], 7);
+    }
+    writeBits(block, offset, bestPBits[0], 1);
+    writeBits(block, offset, bestPBits[1], 1);
+    for (uint32_t t = 0; t < 16; t++) {
+        writeBits(block, offset, bestIndices[t], t == 0 ? 3 : 4);
+    }
+}
+
+void blockcompression::decodeBC7Block(const uint8_t block[16], uint8_t texels[64]) {
+    if ((block[0] & 0x7F) != 0x40) {
+        memset(texels, 0, 64);
+        return;
+    }
+
+    uint32_t offset = 7;
+    uint8_t endpoints[2][4];
+    for (uint32_t c = 0; c < 4; c++) {
+        endpoints[0][c] = static_cast<uint8_t>(readBits(block, offset, 7) << 1);
+        endpoints[1][c] = static_cast<uint8_t>(readBits(block, offset, 7) << 1);
+    }
+    uint32_t pBit0 = readBits(block, offset, 1);
+    uint32_t pBit1 = readBits(block, offset, 1);
+    for (uint32_t c = 0; c < 4; c++) {
+        endpoints[0][c] |= pBit0;
+        endpoints[1][c] |= pBit1;
+    }
+
+    uint8_t palette[16][4];
+    bc7Palette(endpoints[0], endpoints[1], palette);
+    for (uint32_t t = 0; t < 16; t++) {
+        uint32_t index = readBits(block, offset, t == 0 ? 3 : 4);
+        for (uint32_t c = 0; c < 4; c++) {
+            texels[4 * t + c] = palette[index][c];
+        }
+    }
+}
+
+//////////////////////
+//
+// Levels
+//
+//////////////////////
+
+// true for the BC1 formats, false for BC7 ones, throws for any other format
+static bool isBC1(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return false;
+    default:
+        throw std::runtime_error("failed to compress texture, only BC1 and BC7 can be encoded!");
+    }
+}
+
+void blockcompression::compressLevel(const uint8_t* texels, uint32_t width, uint32_t height, VkFormat format, uint32_t refinements, uint8_t* blocks) {
+    bool bc1 = isBC1(format);
+    uint32_t blockBytes = ktx2::blockSize(format);
+    uint32_t blocksWide = (width + KTX2_BLOCK_DIMENSION - 1) / KTX2_BLOCK_DIMENSION;
+    uint32_t blocksHigh = (height + KTX2_BLOCK_DIMENSION - 1) / KTX2_BLOCK_DIMENSION;
+
+    parallel::parallelFor(blocksHigh, [&](size_t begin, size_t end, uint32_t) {
+        uint8_t blockTexels[64];
+        for (size_t by = begin; by < end; by++) {
+            for (uint32_t bx = 0; bx < blocksWide; bx++) {
+                // gather the block, repeating the last row and column of the level past its edges
+                for (uint32_t t = 0; t < 16; t++) {
+                    uint32_t x = std::min(bx * 4 + t % 4, width - 1);
+                    uint32_t y = std::min(static_cast<uint32_t>(by) * 4 + t / 4, height - 1);
+                    std::copy(texels + 4 * ((size_t)y * width + x), texels + 4 * ((size_t)y * width + x) + 4, blockTexels + 4 * t);
+                }
+
+                uint8_t* block = blocks + (by * blocksWide + bx) * blockBytes;
+                if (bc1) {
+                    encodeBC1Block(blockTexels, refinements, block);
+                }
+                else {
+                    encodeBC7Block(blockTexels, refinements, block);
+                }
+            }
+        }
+    });
+}
+
+void blockcompression::decompressLevel(const uint8_t* blocks, uint32_t width, uint32_t height, VkFormat format, uint8_t* texels) {
+    bool bc1 = isBC1(format);
+    uint32_t blockBytes = ktx2::blockSize(format);
+    uint32_t blocksWide = (width + KTX2_BLOCK_DIMENSION - 1) / KTX2_BLOCK_DIMENSION;
+    uint32_t blocksHigh = (height + KTX2_BLOCK_DIMENSION - 1) / KTX2_BLOCK_DIMENSION;
+
+    parallel::parallelFor(blocksHigh, [&](size_t begin, size_t end, uint32_t) {
+        uint8_t blockTexels[64];
+        for (size_t by = begin; by < end; by++) {
+            for (uint32_t bx = 0; bx < blocksWide; bx++) {
+                const uint8_t* block = blocks + (by * blocksWide + bx) * blockBytes;
+                if (bc1) {
+                    decodeBC1Block(block, blockTexels);
+                }
+                else {
+                    decodeBC7Block(block, blockTexels);
+                }
+
+                // only the texels inside the level
+                for (uint32_t t = 0; t < 16; t++) {
+                    uint32_t x = bx * 4 + t % 4;
+                    uint32_t y = static_cast<uint32_t>(by) * 4 + t / 4;
+                    if (x < width && y < height) {
+                        std::copy(blockTexels + 4 * t, blockTexels + 4 * t + 4, texels + 4 * ((size_t)y * width + x));
+                    }
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,298 @@
+//
+// Definition of the bounds computation
+//
+
+#include <Bounds.h>
+
+#include <algorithm> // min
+#include <cmath> // sqrtf
+
+// pick the widest instruction set the compiler targets, x64 always has SSE2
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BOUNDS_USE_AVX
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOUNDS_USE_SSE
+#endif
+
+// the positions are summed in single precision over blocks of this many vertices, then the block sums are added in
+// double precision so that the centroid of large meshes does not lose precision
+const size_t BOUNDS_SUM_BLOCK = 1024;
+
+//////////////////////
+//
+// Shared steps
+//
+//////////////////////
+
+// the indices of the vertices with the smallest and largest coordinate along each axis
+struct Extremes {
+    uint32_t minIndex[3] = { 0, 0, 0 };
+    uint32_t maxIndex[3] = { 0, 0, 0 };
+};
+
+// the initial sphere goes through the pair of extreme points that are furthest apart
+static void initialSphere(const std::vector<Vertex>& vertices, const Extremes& extremes, Bounds& bounds) {
+    float largestDistance = -1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        const glm::vec3& a = vertices[extremes.minIndex[axis]].pos;
+        const glm::vec3& b = vertices[extremes.maxIndex[axis]].pos;
+        float distance = glm::dot(b - a, b - a);
+        if (distance > largestDistance) {
+            largestDistance = distance;
+            bounds.sphereCentre = (a + b) * 0.5f;
+            bounds.sphereRadius = sqrtf(distance) * 0.5f;
+        }
+    }
+}
+
+// grows the sphere just enough to contain the point, the new sphere contains the old one so the points already tested
+// stay inside
+static inline void growSphere(const glm::vec3& point, glm::vec3& centre, float& radius) {
+    glm::vec3 offset = point - centre;
+    float distanceSquared = glm::dot(offset, offset);
+    if (distanceSquared > radius * radius) {
+        float distance = sqrtf(distanceSquared);
+        float newRadius = (radius + distance) * 0.5f;
+        centre += offset * ((newRadius - radius) / distance);
+        radius = newRadius;
+    }
+}
+
+//////////////////////
+//
+// Scalar
+//
+//////////////////////
+
+Bounds bounds::computeBoundsScalar(const std::vector<Vertex>& vertices) {
+    Bounds bounds{};
+    if (vertices.empty()) {
+        return bounds;
+    }
+
+    // box, centroid and extreme points
+    Extremes extremes{};
+    bounds.min = vertices[0].pos;
+    bounds.max = vertices[0].pos;
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        const glm::vec3& pos = vertices[i].pos;
+        for (int axis = 0; axis < 3; axis++) {
+            if (pos[axis] < bounds.min[axis]) {
+                bounds.min[axis] = pos[axis];
+                extremes.minIndex[axis] = i;
+            }
+            if (pos[axis] > bounds.max[axis]) {
+                bounds.max[axis] = pos[axis];
+                extremes.maxIndex[axis] = i;
+            }
+            sum[axis] += pos[axis];
+        }
+    }
+    bounds.centroid = glm::vec3((float)(sum[0] / vertices.size()), (float)(sum[1] / vertices.size()), (float)(sum[2] / vertices.size()));
+
+    // sphere
+    initialSphere(vertices, extremes, bounds);
+    for (const auto& vertex : vertices) {
+        growSphere(vertex.pos, bounds.sphereCentre, bounds.sphereRadius);
+    }
+
+    return bounds;
+}
+
+//////////////////////
+//
+// SIMD
+//
+//////////////////////
+
+#ifdef BOUNDS_USE_SSE
+
+// the position and the first component of the normal, the fourth lane is never used
+static inline __m128 loadPosition(const Vertex& vertex) {
+    return _mm_loadu_ps(&vertex.pos.x);
+}
+
+// lanes of a where mask is set, lanes of b elsewhere
+static inline __m128i selectIndex(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// the first pass, one vertex per register with the x, y and z in the first three lanes
+static void extremesSSE(const std::vector<Vertex>& vertices, Bounds& bounds, Extremes& extremes) {
+    __m128 minimum = loadPosition(vertices[0]);
+    __m128 maximum = minimum;
+    __m128i minimumIndex = _mm_setzero_si128();
+    __m128i maximumIndex = _mm_setzero_si128();
+    double sum[3] = { 0.0, 0.0, 0.0 };
+
+    for (size_t blockStart = 0; blockStart < vertices.size(); blockStart += BOUNDS_SUM_BLOCK) {
+        size_t blockEnd = std::min(blockStart + BOUNDS_SUM_BLOCK, vertices.size());
+        __m128 blockSum = _mm_setzero_ps();
+        for (size_t i = blockStart; i < blockEnd; i++) {
+            __m128 pos = loadPosition(vertices[i]);
+            __m128i index = _mm_set1_epi32(static_cast<int>(i));
+            minimumIndex = selectIndex(_mm_castps_si128(_mm_cmplt_ps(pos, minimum)), index, minimumIndex);
+            maximumIndex = selectIndex(_mm_castps_si128(_mm_cmpgt_ps(pos, maximum)), index, maximumIndex);
+            minimum = _mm_min_ps(pos, minimum);
+            maximum = _mm_max_ps(pos, maximum);
+            blockSum = _mm_add_ps(blockSum, pos);
+        }
+        float partial[4];
+        _mm_storeu_ps(partial, blockSum);
+        for (int axis = 0; axis < 3; axis++) {
+            sum[axis] += partial[axis];
+        }
+    }
+
+    float minimumLanes[4], maximumLanes[4];
+    uint32_t minimumIndexLanes[4], maximumIndexLanes[4];
+    _mm_storeu_ps(minimumLanes, minimum);
+    _mm_storeu_ps(maximumLanes, maximum);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(minimumIndexLanes), minimumIndex);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maximumIndexLanes), maximumIndex);
+    for (int axis = 0; axis < 3; axis++) {
+        bounds.min[axis] = minimumLanes[axis];
+        bounds.max[axis] = maximumLanes[axis];
+        extremes.minIndex[axis] = minimumIndexLanes[axis];
+        extremes.maxIndex[axis] = maximumIndexLanes[axis];
+    }
+    bounds.centroid = glm::vec3((float)(sum[0] / vertices.size()), (float)(sum[1] / vertices.size()), (float)(sum[2] / vertices.size()));
+}
+
+#ifdef BOUNDS_USE_AVX
+
+// the first pass, two vertices per register, one in each 128 bit half. The halves are merged at the end
+static void extremesAVX(const std::vector<Vertex>& vertices, Bounds& bounds, Extremes& extremes) {
+    size_t pairCount = vertices.size() / 2;
+    if (pairCount == 0) {
+        extremesSSE(vertices, bounds, extremes);
+        return;
+    }
+
+    auto loadPair = [&](size_t i) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(loadPosition(vertices[i])), loadPosition(vertices[i + 1]), 1);
+    };
+    __m256 minimum = loadPair(0);
+    __m256 maximum = minimum;
+    // the indices are kept as floats only to be moved around by the blends, their bits are never interpreted
+    __m256 minimumIndex = _mm256_castsi256_ps(_mm256_set_epi32(1, 1, 1, 1, 0, 0, 0, 0));
+    __m256 maximumIndex = minimumIndex;
+    double sum[3] = { 0.0, 0.0, 0.0 };
+
+    for (size_t blockStart = 0; blockStart < pairCount; blockStart += BOUNDS_SUM_BLOCK) {
+        size_t blockEnd = std::min(blockStart + BOUNDS_SUM_BLOCK, pairCount);
+        __m256 blockSum = _mm256_setzero_ps();
+        for (size_t pair = blockStart; pair < blockEnd; pair++) {
+            size_t i = 2 * pair;
+            __m256 pos = loadPair(i);
+            int first = static_cast<int>(i), second = static_cast<int>(i + 1);
+            __m256 index = _mm256_castsi256_ps(_mm256_set_epi32(second, second, second, second, first, first, first, first));
+            minimumIndex = _mm256_blendv_ps(minimumIndex, index, _mm256_cmp_ps(pos, minimum, _CMP_LT_OQ));
+            maximumIndex = _mm256_blendv_ps(maximumIndex, index, _mm256_cmp_ps(pos, maximum, _CMP_GT_OQ));
+            minimum = _mm256_min_ps(pos, minimum);
+            maximum = _mm256_max_ps(pos, maximum);
+            blockSum = _mm256_add_ps(blockSum, pos);
+        }
+        float partial[8];
+        _mm256_storeu_ps(partial, blockSum);
+        for (int axis = 0; axis < 3; axis++) {
+            sum[axis] += (double)partial[axis] + (double)partial[4 + axis];
+        }
+    }
+
+    float minimumLanes[8], maximumLanes[8];
+    uint32_t minimumIndexLanes[8], maximumIndexLanes[8];
+    _mm256_storeu_ps(minimumLanes, minimum);
+    _mm256_storeu_ps(maximumLanes, maximum);
+    _mm256_storeu_ps(reinterpret_cast<float*>(minimumIndexLanes), minimumIndex);
+    _mm256_storeu_ps(reinterpret_cast<float*>(maximumIndexLanes), maximumIndex);
+
+    // merge the two halves, then the last vertex if the count is odd
+    for (int axis = 0; axis < 3; axis++) {
+        bool upperMin = minimumLanes[4 + axis] < minimumLanes[axis];
+        bool upperMax = maximumLanes[4 + axis] > maximumLanes[axis];
+        bounds.min[axis] = upperMin ? minimumLanes[4 + axis] : minimumLanes[axis];
+        bounds.max[axis] = upperMax ? maximumLanes[4 + axis] : maximumLanes[axis];
+        extremes.minIndex[axis] = upperMin ? minimumIndexLanes[4 + axis] : minimumIndexLanes[axis];
+        extremes.maxIndex[axis] = upperMax ? maximumIndexLanes[4 + axis] : maximumIndexLanes[axis];
+    }
+    if (vertices.size() % 2 == 1) {
+        uint32_t last = static_cast<uint32_t>(vertices.size() - 1);
+        const glm::vec3& pos = vertices[last].pos;
+        for (int axis = 0; axis < 3; axis++) {
+            if (pos[axis] < bounds.min[axis]) {
+                bounds.min[axis] = pos[axis];
+                extremes.minIndex[axis] = last;
+            }
+            if (pos[axis] > bounds.max[axis]) {
+                bounds.max[axis] = pos[axis];
+                extremes.maxIndex[axis] = last;
+            }
+            sum[axis] += pos[axis];
+        }
+    }
+    bounds.centroid = glm::vec3((float)(sum[0] / vertices.size()), (float)(sum[1] / vertices.size()), (float)(sum[2] / vertices.size()));
+}
+
+#endif // BOUNDS_USE_AVX
+
+// the second pass, tests four vertices at a time against the sphere and only grows it one vertex at a time for the
+// few that are outside, most of the vertices are inside once the first ones have grown it
+static void sphereSSE(const std::vector<Vertex>& vertices, Bounds& bounds) {
+    glm::vec3& centre = bounds.sphereCentre;
+    float& radius = bounds.sphereRadius;
+
+    size_t i = 0;
+    for (; i + 4 <= vertices.size(); i += 4) {
+        // transpose to one register per axis
+        __m128 x = loadPosition(vertices[i + 0]);
+        __m128 y = loadPosition(vertices[i + 1]);
+        __m128 z = loadPosition(vertices[i + 2]);
+        __m128 w = loadPosition(vertices[i + 3]);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        __m128 dx = _mm_sub_ps(x, _mm_set1_ps(centre.x));
+        __m128 dy = _mm_sub_ps(y, _mm_set1_ps(centre.y));
+        __m128 dz = _mm_sub_ps(z, _mm_set1_ps(centre.z));
+        __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        int outside = _mm_movemask_ps(_mm_cmpgt_ps(distanceSquared, _mm_set1_ps(radius * radius)));
+
+        // growSphere tests each of them again, an earlier lane may already have grown the sphere over it
+        for (int lane = 0; outside != 0 && lane < 4; lane++) {
+            if (outside & (1 << lane)) {
+                growSphere(vertices[i + lane].pos, centre, radius);
+            }
+        }
+    }
+    for (; i < vertices.size(); i++) {
+        growSphere(vertices[i].pos, centre, radius);
+    }
+}
+
+#endif // BOUNDS_USE_SSE
+
+Bounds bounds::computeBounds(const std::vector<Vertex>& vertices) {
+#ifdef BOUNDS_USE_SSE
+    Bounds bounds{};
+    if (vertices.empty()) {
+        return bounds;
+    }
+
+    Extremes extremes{};
+#ifdef BOUNDS_USE_AVX
+    extremesAVX(vertices, bounds, extremes);
+#else
+    extremesSSE(vertices, bounds, extremes);
+#endif
+    initialSphere(vertices, extremes, bounds);
+    sphereSSE(vertices, bounds);
+    return bounds;
+#else
+    return computeBoundsScalar(vertices);
+#endif
+}
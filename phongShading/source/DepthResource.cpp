@@ -14,7 +14,7 @@
 //
 //////////////////////
 
-void DepthResource::createDepthResource(const VulkanSetup* vkSetup, const VkExtent2D& extent, VkCommandPool commandPool) {
+void DepthResource::createDepthResource(VulkanSetup* vkSetup, const VkExtent2D& extent, VkCommandPool commandPool) {
     // depth image should have the same resolution as the colour attachment, defined by swap chain extent
     VkFormat depthFormat = findDepthFormat(vkSetup); // find a depth format
 
@@ -29,7 +29,7 @@ void DepthResource::createDepthResource(const VulkanSetup* vkSetup, const VkExte
     info.image       = &depthImage;
     info.imageMemory = &depthImageMemory;
 
-    utils::createImage(&vkSetup->device, &vkSetup->physicalDevice, info);
+    utils::createImage(&vkSetup->device, &vkSetup->memoryAllocator, info);
     depthImageView = utils::createImageView(&vkSetup->device, depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 
     TransitionImageLayoutData transitionData{};
@@ -75,7 +75,8 @@ void DuckApplication::initVulkan() {
     // create the descriptor set layout and render command pool BEFORE the swap chain
     // these do not change over the lifetime of the application
     createDescriptorSetLayout();
-    createCommandPool(&renderCommandPool, 0);
+    // the geometry command buffer of a swap chain image is recorded again when the texture it samples is swapped
+    createCommandPool(&renderCommandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     createCommandPool(&imGuiCommandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
     //
@@ -91,20 +92,49 @@ void DuckApplication::initVulkan() {
     // STEP 4: Create the application's data (models, textures...)
     //
 
-    // textures can go in a separate class
-    duckTexture.createTexture(&vkSetup, TEXTURE_PATH, renderCommandPool);
+    // the data is written straight into mapped staging memory by the loaders
+    stagingBuffer.createStagingBuffer(&vkSetup);
+    // and the uploads from it are recorded into a single command buffer rather than waited on one at a time
+    uploadBatcher.createUploadBatcher(&vkSetup, &stagingBuffer, renderCommandPool);
+
+    // textures are shared through the cache
+    textureCache.createTextureCache(&vkSetup, &stagingBuffer, &uploadBatcher);
+    // streamed in while the first frames are drawn with a placeholder, or loaded as a batch decoded on all cores and
+    // uploaded with a single submit
+    if (streamTextures) {
+        duckTexture = textureCache.acquireTexture(TEXTURE_PATH, true);
+    }
+    else {
+        duckTexture = textureCache.acquireTextures({ TEXTURE_PATH })[0];
+    }
 
     // model can go in a separate class
+    duckModel.packVertexAttributes = usePackedVertices;
+    duckModel.recomputeNormals = recomputeModelNormals;
     duckModel.loadModel(MODEL_PATH);
 
+    // the textures are bound once in the table, each material samples the one at its index. Every material of the
+    // duck uses the same texture
+    textureTable.createTextureTable(&vkSetup);
+    uint32_t duckTextureIndex = textureTable.addTexture(duckTexture);
+    for (auto& material : duckModel.materials) {
+        material.textureIndex = duckTextureIndex;
+    }
+
     //
     // STEP 5: create the vulkan data for accessing and using the app's data
     //
 
     // these depend on the size of the framebuffer, so create them after 
-    createVertexBuffer();
-    createIndexBuffer();
+    createGeometryArena();
+    createMaterialBuffer();
+    // every upload of the loading phase is submitted at once. With a transfer queue the graphics queue only acquires the
+    // buffers once the copies are done, and the first frames draw from them, so the loading phase waits for the batch
+    // once. On the graphics queue alone the batch ends with a barrier that makes the data visible to the frames
+    // submitted after it. Its staging regions are freed once its fence is signaled
+    uploadBatcher.wait(uploadBatcher.submit());
     createUniformBuffers();
+    createIndirectBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers(&renderCommandBuffers, renderCommandPool);
@@ -158,9 +188,9 @@ void DuckApplication::initImGui() {
 }
 
 void DuckApplication::uploadFonts() {
-    VkCommandBuffer commandbuffer = utils::beginSingleTimeCommands(&vkSetup.device, imGuiCommandPool);
-    ImGui_ImplVulkan_CreateFontsTexture(commandbuffer);
-    utils::endSingleTimeCommands(&vkSetup.device, &vkSetup.graphicsQueue, &commandbuffer, &imGuiCommandPool);
+    // in a batch of its own, submitted before the first frame
+    ImGui_ImplVulkan_CreateFontsTexture(uploadBatcher.recordGraphics());
+    uploadBatcher.submit();
 }
 
 //////////////////////
@@ -194,24 +224,32 @@ void DuckApplication::initWindow() {
 void DuckApplication::createDescriptorSetLayout() {
     // provide details about every descriptor binding used in the shaders
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // this is a uniform descriptor
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // a uniform descriptor, whose offset in the uniform ring is given when binding the set
     // specify binding used
     uboLayoutBinding.binding = 0; // the first descriptor
     uboLayoutBinding.descriptorCount = 1; // single uniform buffer object so just 1, could be used to specify a transform for each bone in a skeletal animation
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // in which shader stage is the descriptor going to be referenced
     uboLayoutBinding.pImmutableSamplers = nullptr; // relevant to image sampling related descriptors
 
-    // same as above but for a texture sampler rather than for uniforms
+    // same as above but for the texture table rather than for uniforms
     VkDescriptorSetLayoutBinding samplerLayoutBinding{};
     samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; // this is a sampler descriptor
     samplerLayoutBinding.binding = 1; // the second descriptor
-    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorCount = vkSetup.textureTableSize; // an array of samplers, indexed with the texture index of the material
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; ;// the shader stage we wan the descriptor to be used in, ie the fragment shader stage
     // can use the texture sampler in the vertex stage as part of a height map to deform the vertices in a grid
     samplerLayoutBinding.pImmutableSamplers = nullptr;
 
+    // the material table, read by the fragment shader with the material index of the draw
+    VkDescriptorSetLayoutBinding materialLayoutBinding{};
+    materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // a storage buffer, its size is only known once the model is loaded
+    materialLayoutBinding.binding = 2; // the third descriptor
+    materialLayoutBinding.descriptorCount = 1;
+    materialLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    materialLayoutBinding.pImmutableSamplers = nullptr;
+
     // put the descriptors in an array
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, samplerLayoutBinding, materialLayoutBinding };
     
     // descriptor set bindings combined into a descriptor set layour object, created the same way as other vk objects by filling a struct in
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
@@ -229,19 +267,19 @@ void DuckApplication::createDescriptorPool() {
     // to create a descriptor pool to get the descriptor set (much like the command pool for command queues)
 
     // from the ImGUI example function, the pool sizes have a descriptor count of 1000
-    // we also need to allocate one pool for each frame for our descriptors (uniform and texture sampler)
+    // we also need to allocate one pool for each frame for our descriptors (uniform, texture table and material table)
     uint32_t swapChainImageCount = static_cast<uint32_t>(swapChainData.images.size());
     VkDescriptorPoolSize poolSizes[] =
     {
         { VK_DESCRIPTOR_TYPE_SAMPLER, IMGUI_POOL_NUM },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, IMGUI_POOL_NUM + swapChainImageCount },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, IMGUI_POOL_NUM + swapChainImageCount * vkSetup.textureTableSize },
         { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, IMGUI_POOL_NUM },
         { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, IMGUI_POOL_NUM },
         { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, IMGUI_POOL_NUM },
         { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, IMGUI_POOL_NUM },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, IMGUI_POOL_NUM + swapChainImageCount},
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, IMGUI_POOL_NUM },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, IMGUI_POOL_NUM },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, IMGUI_POOL_NUM },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, IMGUI_POOL_NUM + swapChainImageCount },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, IMGUI_POOL_NUM + swapChainImageCount },
         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, IMGUI_POOL_NUM },
         { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, IMGUI_POOL_NUM }
     };
@@ -287,15 +325,15 @@ void DuckApplication::createDescriptorSets() {
     for (size_t i = 0; i < swapChainData.images.size(); i++) {
         // the buffer and the region of it that contain the data for the descriptor
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i]; // contents of buffer for image i
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject); // here this is the size of the whole buffer, we can use VK_WHOLE_SIZE instead
+        bufferInfo.buffer = uniformRing.buffer; // the uniform ring, shared by every image
+        bufferInfo.offset = 0; // the dynamic offset given when binding is added to this one
+        bufferInfo.range = sizeof(UniformBufferObject); // the size of the uniforms read at the dynamic offset
 
-        // bind the actual image and sampler to the descriptors in the descriptor set
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = duckTexture.textureImageView;
-        imageInfo.sampler = duckTexture.textureSampler;
+        // the whole material table, the same buffer for every frame as it never changes
+        VkDescriptorBufferInfo materialBufferInfo{};
+        materialBufferInfo.buffer = materialBuffer;
+        materialBufferInfo.offset = 0;
+        materialBufferInfo.range = VK_WHOLE_SIZE;
 
         // the struct configuring the descriptor set
         std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
@@ -305,29 +343,42 @@ void DuckApplication::createDescriptorSets() {
         descriptorWrites[0].dstBinding = 0; // uniform buffer has binding 0
         descriptorWrites[0].dstArrayElement = 0; // descriptors can be arrays, only one element so first index
         // type of descriptor again
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         descriptorWrites[0].descriptorCount = 1; // can update multiple descriptors at once starting at dstArrayElement, descriptorCount specifies how many elements
 
         descriptorWrites[0].pBufferInfo = &bufferInfo; // for descriptors that use buffer data
         descriptorWrites[0].pImageInfo = nullptr; // for image data
         descriptorWrites[0].pTexelBufferView = nullptr; // desciptors refering to buffer views
 
-        // the texture sampler
+        // material table
         descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1; // sampler has binding 1
-        descriptorWrites[1].dstArrayElement = 0; // only one element so index 0
-        // type of descriptor again
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].dstBinding = 2; // material table has binding 2
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         descriptorWrites[1].descriptorCount = 1;
-
-        descriptorWrites[1].pBufferInfo = nullptr; // for descriptors that use buffer data
-        descriptorWrites[1].pImageInfo = &imageInfo; // for image data
-        descriptorWrites[1].pTexelBufferView = nullptr; // desciptors refering to buffer views
+        descriptorWrites[1].pBufferInfo = &materialBufferInfo;
+        descriptorWrites[1].pImageInfo = nullptr;
+        descriptorWrites[1].pTexelBufferView = nullptr;
 
         // update according to the configuration
         vkUpdateDescriptorSets(vkSetup.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+        // the texture table has binding 1
+        textureTable.writeDescriptors(descriptorSets[i], 1);
     }
+
+    // every set has the current texture view
+    staleTextureDescriptors.assign(swapChainData.images.size(), false);
+}
+
+void DuckApplication::updateTextureDescriptor(size_t imageIndex) {
+    // only the texture table changes, the set must not be in use by a command buffer that is pending
+    textureTable.writeDescriptors(descriptorSets[imageIndex], 1);
+
+    // updating the set invalidates the command buffer it was bound in
+    recordGemoetryCommandBuffer(imageIndex, 1);
+    staleTextureDescriptors[imageIndex] = false;
 }
 
 //////////////////////
@@ -337,16 +388,15 @@ void DuckApplication::createDescriptorSets() {
 //////////////////////
 
 void DuckApplication::createUniformBuffers() {
-    // specify what the size of the buffer is
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-    // resize the uniform buffer to be as big as the swap chain, each image has its own set of uniforms
-    uniformBuffers.resize(swapChainData.images.size());
-    uniformBuffersMemory.resize(swapChainData.images.size());
+    // a slice of the ring per swap chain image, as the geometry command buffers are recorded once per image with the
+    // dynamic offset of its uniforms. A slice is rewritten once the fence of the image's previous frame is signaled
+    uint32_t swapChainImageCount = static_cast<uint32_t>(swapChainData.images.size());
+    uniformRing.createUniformRing(&vkSetup, swapChainImageCount);
 
-    // loop over the images and create a uniform buffer for each
-    for (size_t i = 0; i < swapChainData.images.size(); i++) {
-        utils::createBuffer(&vkSetup.device, &vkSetup.physicalDevice, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+    // the uniforms are the first allocation of each slice
+    uniformOffsets.resize(swapChainImageCount);
+    for (uint32_t i = 0; i < swapChainImageCount; i++) {
+        uniformOffsets[i] = uniformRing.sliceOffset(i);
     }
 }
 
@@ -394,11 +444,73 @@ void DuckApplication::updateUniformBuffer(uint32_t currentImage) {
     ubo.diffuse = glm::vec3(diffuse[0], diffuse[1], diffuse[2]);
     ubo.specular = glm::vec4(specular[0], specular[1], specular[2], specularExp);
 
-    // copy the uniform buffer object into the uniform buffer
-    void* data;
-    vkMapMemory(vkSetup.device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(vkSetup.device, uniformBuffersMemory[currentImage]);
+    // copy the uniform buffer object into the image's slice of the uniform ring, which stays mapped. The uniforms of
+    // other objects would be allocated after these
+    uniformRing.beginSlice(currentImage);
+    UniformAllocation uniforms = uniformRing.allocate(sizeof(ubo));
+    memcpy(uniforms.data, &ubo, sizeof(ubo));
+
+    // the command buffer binds the set with the offset it was recorded with, it is not pending as the image's fence was waited on
+    if (uniforms.offset != uniformOffsets[currentImage]) {
+        uniformOffsets[currentImage] = uniforms.offset;
+        recordGemoetryCommandBuffer(currentImage, 1);
+    }
+
+    // the level of detail is chosen and its meshlets are culled with the same transformations
+    updateDrawCommands(currentImage, ubo.proj, ubo.view * ubo.model);
+}
+
+void DuckApplication::updateDrawCommands(uint32_t currentImage, const glm::mat4& proj, const glm::mat4& modelView) {
+    glm::mat4 modelViewProj = proj * modelView;
+
+    // the size of the model on screen in pixels, its scaled span seen at the distance of its centre
+    glm::vec3 centre = glm::vec3(modelView * glm::vec4(duckModel.centreOfGravity, 1.0f));
+    float scale = glm::length(glm::vec3(modelView[0]));
+    float projectedSpan = duckModel.modelSpan * scale * fabsf(proj[1][1]) * 0.5f * swapChainData.extent.height / std::max(-centre.z, 1e-3f);
+
+    // pick the level of detail, or the one chosen in the UI
+    if (forcedLod >= 0) {
+        currentLod = std::min(static_cast<uint32_t>(forcedLod), static_cast<uint32_t>(duckModel.lods.size()) - 1);
+    }
+    else {
+        currentLod = duckModel.selectLod(projectedSpan, lodErrorThreshold);
+    }
+    const ModelLod& lod = duckModel.lods[currentLod];
+
+    // a zoom of 0 collapses the model to a point and leaves no camera position to test the normal cones against
+    if (enableMeshletCulling && lod.meshletCount > 0 && glm::determinant(modelView) != 0.0f) {
+        // the camera is at the origin of the view space, bring it into model space where the meshlet bounds are
+        glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        visibleMeshlets = meshlets::cullMeshlets(duckModel.meshlets, lod.firstMeshlet, lod.meshletCount, modelViewProj, cameraPosition, drawCommands);
+    }
+    else {
+        // a draw per submesh of the level, they are in material order like the meshlets
+        drawCommands.clear();
+        for (uint32_t s = lod.firstSubmesh; s < lod.firstSubmesh + lod.submeshCount; s++) {
+            VkDrawIndexedIndirectCommand drawCommand{};
+            drawCommand.indexCount = duckModel.submeshes[s].indexCount;
+            drawCommand.instanceCount = 1;
+            drawCommand.firstIndex = duckModel.submeshes[s].firstIndex;
+            // gl_InstanceIndex in the vertex shader, which passes it on to the fragment shader to index the material table
+            drawCommand.firstInstance = duckModel.submeshes[s].materialIndex;
+            drawCommands.push_back(drawCommand);
+        }
+        visibleMeshlets = lod.meshletCount;
+    }
+
+    // the model's indices are relative to its first vertex, and start at its first index in the arena
+    for (auto& drawCommand : drawCommands) {
+        drawCommand.firstIndex += duckGeometry.firstIndex;
+        drawCommand.vertexOffset = static_cast<int32_t>(duckGeometry.firstVertex);
+    }
+
+    // the draws that are not needed this frame draw nothing
+    activeDraws = static_cast<uint32_t>(drawCommands.size());
+    drawCommands.resize(indirectDrawCount, VkDrawIndexedIndirectCommand{});
+
+    // copy the draws into the indirect buffer of the image, like the uniforms
+    VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * indirectDrawCount;
+    memcpy(indirectBuffersMemory[currentImage].mapped, drawCommands.data(), (size_t)bufferSize);
 }
 
 //////////////////////
@@ -446,9 +558,9 @@ void DuckApplication::createCommandBuffers(std::vector<VkCommandBuffer>* command
     }
 }
 
-void DuckApplication::recordGemoetryCommandBuffer() {
-    // start recording a command buffer 
-    for (size_t i = 0; i < renderCommandBuffers.size(); i++) {
+void DuckApplication::recordGemoetryCommandBuffer(size_t firstImage, size_t imageCount) {
+    // start recording a command buffer for each swap chain image in the range
+    for (size_t i = firstImage; i < renderCommandBuffers.size() && i - firstImage < imageCount; i++) {
         // the following struct used as argument specifying details about the usage of specific command buffer
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -490,15 +602,10 @@ void DuckApplication::recordGemoetryCommandBuffer() {
             // bind the graphics pipeline, second param determines if the object is a graphics or compute pipeline
         vkCmdBindPipeline(renderCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, swapChainData.graphicsPipeline);
 
-        VkBuffer vertexBuffers[] = { vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        // bind the vertex buffer, can have many vertex buffers
-        vkCmdBindVertexBuffers(renderCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-        // bind the index buffer, can only have a single index buffer 
-        // params (-the nescessary cmd) bufferindex buffer, byte offset into it, type of data
-        vkCmdBindIndexBuffer(renderCommandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        // bind the uniform descriptor sets
-        vkCmdBindDescriptorSets(renderCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, swapChainData.graphicsPipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+        // bind the vertex streams and the indices of every mesh at once, they all live in the geometry arena
+        geometryArena.bind(renderCommandBuffers[i]);
+        // bind the uniform descriptor sets, with the offset of the image's uniforms in the uniform ring
+        vkCmdBindDescriptorSets(renderCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, swapChainData.graphicsPipelineLayout, 0, 1, &descriptorSets[i], 1, &uniformOffsets[i]);
 
         // command to draw the vertices in the vertex buffer
         //vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0); 
@@ -508,7 +615,7 @@ void DuckApplication::recordGemoetryCommandBuffer() {
         // first vertex, offset into the vertex buffer. Defines lowest value of gl_VertexIndex
         // first instance, offset for instance rendering. Defines lowest value of gl_InstanceIndex
 
-        vkCmdDrawIndexed(renderCommandBuffers[i], static_cast<uint32_t>(duckModel.indices.size()), 1, 0, 0, 0);
+        //vkCmdDrawIndexed(renderCommandBuffers[i], duckModel.lods[0].indexCount, 1, 0, 0, 0);
         // params :
         // the command buffer
         // the indices
@@ -517,11 +624,12 @@ void DuckApplication::recordGemoetryCommandBuffer() {
         // offest to add to the indices in the index buffer
         // offest for instancing
 
-        // /!\ about vertex and index buffers /!\
-            // The previous chapter already mentioned that should allocate multiple resources like buffers 
-            // from a single memory allocation. Even better, Driver developers recommend to store multiple buffers, 
-            // like the vertex and index buffer, into a single VkBuffer and use  offsets in commands like vkCmdBindVertexBuffers. 
-            // The advantage is that your data is more cache friendly, because it's closer together. 
+        // the same parameters are read from the indirect buffer instead, which holds the draws of the visible meshlets
+        // written before each frame. Issue as many of them per command as the device allows
+        for (uint32_t firstDraw = 0; firstDraw < indirectDrawCount; firstDraw += vkSetup.maxDrawIndirectCount) {
+            uint32_t count = std::min(indirectDrawCount - firstDraw, vkSetup.maxDrawIndirectCount);
+            vkCmdDrawIndexedIndirect(renderCommandBuffers[i], indirectBuffers[i], firstDraw * sizeof(VkDrawIndexedIndirectCommand), count, sizeof(VkDrawIndexedIndirectCommand));
+        }
 
         // end the render pass
         vkCmdEndRenderPass(renderCommandBuffers[i]);
@@ -535,62 +643,52 @@ void DuckApplication::recordGemoetryCommandBuffer() {
 
 //////////////////////
 //
-// Vertex buffer / Index buffer setup
+// Geometry arena / Buffers setup
 //
 //////////////////////
 
-void DuckApplication::createVertexBuffer() {
-    // precompute buffer size
-    VkDeviceSize bufferSize = sizeof(duckModel.vertices[0]) * duckModel.vertices.size();
-    // call our helper buffer creation function
-
-    // use a staging buffer for mapping and copying 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    // in host memory (cpu)
-    utils::createBuffer(&vkSetup.device, &vkSetup.physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-    // VK_BUFFER_USAGE_TRANSFER_SRC_BIT: Buffer can be used as source in a memory transfer operation.
-
-    void* data;
-    // access a region in memory ressource defined by offset and size (0 and bufferInfo.size), can use special value VK_WHOLE_SIZE to map all of the memory
-    // second to last is for flages (none in current API so set to 0), last is output for pointer to mapped memory
-    vkMapMemory(vkSetup.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, duckModel.vertices.data(), (size_t)bufferSize); // memcpy the data in the vertex list to that region in memory
-    vkUnmapMemory(vkSetup.device, stagingBufferMemory); // unmap the memory 
-    // possible issues as driver may not immediately copy data into buffer memory, writes to buffer may not be visible in mapped memory yet...
-    // either use a heap that is host coherent (VK_MEMORY_PROPERTY_HOST_COHERENT_BIT in memory requirements)
-    // or call vkFlushMappedMemoryRanges after writing to mapped memory, and call vkInvalidateMappedMemoryRanges before reading from the mapped memory
-
-    // create the vertex buffer, now the memory is device local (faster)
-    utils::createBuffer(&vkSetup.device, &vkSetup.physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-    // VK_BUFFER_USAGE_TRANSFER_DST_BIT: Buffer can be used as destination in a memory transfer operation
-    utils::copyBuffer(&vkSetup.device, &vkSetup.graphicsQueue, renderCommandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-    // cleanup after using the staging buffer
-    vkDestroyBuffer(vkSetup.device, stagingBuffer, nullptr);
-    vkFreeMemory(vkSetup.device, stagingBufferMemory, nullptr);
+void DuckApplication::createGeometryArena() {
+    // the attribute stream of the arena is in the format chosen for the pipeline, like the model's
+    VkDeviceSize attributeStride = usePackedVertices ? sizeof(PackedVertexAttributes) : sizeof(VertexAttributes);
+    geometryArena.createGeometryArena(&vkSetup, &stagingBuffer, &uploadBatcher, attributeStride);
+
+    // the duck's vertices and indices go in a range of the arena, its draws are offset by where the range starts
+    duckGeometry = geometryArena.addMesh(duckModel);
 }
 
-void DuckApplication::createIndexBuffer() {
-    // almost identical to the vertex buffer creation process except where commented
-    VkDeviceSize bufferSize = sizeof(duckModel.indices[0]) * duckModel.indices.size();
+void DuckApplication::createIndirectBuffers() {
+    // room for one draw per meshlet of the level of detail with the most, or one per submesh of a whole level
+    indirectDrawCount = 1;
+    for (const auto& lod : duckModel.lods) {
+        indirectDrawCount = std::max({ indirectDrawCount, lod.meshletCount, lod.submeshCount });
+    }
+    VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * indirectDrawCount;
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    utils::createBuffer(&vkSetup.device, &vkSetup.physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    // written by the cpu every frame, so kept in host visible memory like the uniform buffers
+    indirectBuffers.resize(swapChainData.images.size());
+    indirectBuffersMemory.resize(swapChainData.images.size());
 
-    void* data;
-    vkMapMemory(vkSetup.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, duckModel.indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(vkSetup.device, stagingBufferMemory);
+    for (size_t i = 0; i < swapChainData.images.size(); i++) {
+        utils::createBuffer(&vkSetup.device, &vkSetup.memoryAllocator, bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indirectBuffers[i], indirectBuffersMemory[i]);
+    }
+}
 
-    // different usage bit flag VK_BUFFER_USAGE_INDEX_BUFFER_BIT instead of VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
-    utils::createBuffer(&vkSetup.device, &vkSetup.physicalDevice,bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+void DuckApplication::createMaterialBuffer() {
+    // the material table never changes, so it goes in device local memory like the vertices
+    VkDeviceSize bufferSize = sizeof(Material) * duckModel.materials.size();
 
-    utils::copyBuffer(&vkSetup.device, &vkSetup.graphicsQueue, renderCommandPool, stagingBuffer, indexBuffer, bufferSize);
+    StagingRegion staging = stagingBuffer.allocate(bufferSize, 16);
+    memcpy(staging.data, duckModel.materials.data(), (size_t)bufferSize);
 
-    vkDestroyBuffer(vkSetup.device, stagingBuffer, nullptr);
-    vkFreeMemory(vkSetup.device, stagingBufferMemory, nullptr);
+    utils::createBuffer(&vkSetup.device, &vkSetup.memoryAllocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, materialBuffer, materialBufferMemory);
+
+    // recorded into the batch of the loading phase, which frees the staging region once it is done
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = staging.offset;
+    copyRegion.size = bufferSize;
+    vkCmdCopyBuffer(uploadBatcher.recordTransfer(), staging.buffer, materialBuffer, 1, &copyRegion);
+    uploadBatcher.transferBufferOwnership(materialBuffer, 0, bufferSize, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    uploadBatcher.freeAfterUpload(staging);
 }
 
 //////////////////////
@@ -618,12 +716,18 @@ void DuckApplication::recreateVulkanData() {
     vkFreeCommandBuffers(vkSetup.device, renderCommandPool, static_cast<uint32_t>(renderCommandBuffers.size()), renderCommandBuffers.data());
     vkFreeCommandBuffers(vkSetup.device, imGuiCommandPool, static_cast<uint32_t>(imGuiCommandBuffers.size()), imGuiCommandBuffers.data());
     
-    // also destroy the uniform buffers that worked with the swap chain
+    // also destroy the uniform ring and the indirect buffers that worked with the swap chain
+    uniformRing.cleanupUniformRing();
     for (size_t i = 0; i < swapChainData.images.size(); i++) {
-        vkDestroyBuffer(vkSetup.device, uniformBuffers[i], nullptr);
-        vkFreeMemory(vkSetup.device, uniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(vkSetup.device, indirectBuffers[i], nullptr);
+        vkSetup.memoryAllocator.free(indirectBuffersMemory[i]);
     }
 
+    // and the descriptor sets that referred to them, returned to the pool so that there is room for the new ones (each
+    // set holds a whole texture table)
+    vkFreeDescriptorSets(vkSetup.device, descriptorPool, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data());
+    descriptorSets.clear();
+
     // destroy the framebuffer data, followed by the swap chain data
     framebufferData.cleanupFrambufferData();
     swapChainData.cleanupSwapChainData();
@@ -634,6 +738,7 @@ void DuckApplication::recreateVulkanData() {
 
     // recreate descriptor data
     createUniformBuffers(); 
+    createIndirectBuffers();
     createDescriptorSets();
 
     // recreate command buffers
@@ -721,6 +826,15 @@ void DuckApplication::drawFrame() {
     // at the start of the frame, make sure that the previous frame has finished which will signal the fence
     //vkWaitForFences(vkSetup.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+    // free the staging memory of the upload batches that are done
+    uploadBatcher.update();
+
+    // upload the streamed texture once it is decoded and swap it in once uploaded, the descriptor set of each swap chain
+    // image is then pointed to it the next time that image is drawn to
+    if (textureCache.updateStreaming()) {
+        std::fill(staleTextureDescriptors.begin(), staleTextureDescriptors.end(), true);
+    }
+
     // retrieve an image from the swap chain
     // swap chain is an extension so use the vk*KHR function
     VkResult result = vkAcquireNextImageKHR(vkSetup.device, swapChainData.swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex); // params:
@@ -747,6 +861,11 @@ void DuckApplication::drawFrame() {
     // Mark the image as now being in use by this frame
     imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
+    // the previous frame drawn to this image is done, so its descriptor set can point to a newly streamed texture
+    if (staleTextureDescriptors[imageIndex]) {
+        updateTextureDescriptor(imageIndex);
+    }
+
     // update the unifrom buffer before submitting
     updateUniformBuffer(imageIndex);
 
@@ -854,6 +973,32 @@ void DuckApplication::renderUI() {
     ImGui::SliderFloat("Specular exponent", &specularExp, 0.0f, 50.0f);
     ImGui::End();
 
+    ImGui::Begin("Model statistics");
+    ImGui::Text("Face corners: %llu", (unsigned long long)duckModel.stats.faceCorners);
+    ImGui::Text("Unique vertices: %llu", (unsigned long long)duckModel.stats.uniqueVertices);
+    ImGui::Text("Dedupe ratio: %.2f", duckModel.stats.dedupeRatio);
+    ImGui::Text("ACMR: %.3f -> %.3f", duckModel.stats.acmrBefore, duckModel.stats.acmrAfter);
+    ImGui::Text("Vertex fetch misses: %llu -> %llu", (unsigned long long)duckModel.stats.fetchMissesBefore,
+        (unsigned long long)duckModel.stats.fetchMissesAfter);
+    if (textureCache.batchStats.textureCount > 0) {
+        const TextureBatchStats& textureStats = textureCache.batchStats;
+        ImGui::Text("Textures: %zu loaded, %zu created, %zu KB uploaded", textureStats.textureCount, textureStats.createdCount, textureStats.uploadedBytes / 1024);
+        ImGui::Text("Texture load: %.1f ms io, %.1f ms decode, %.1f ms record", textureStats.ioTime, textureStats.decodeTime, textureStats.recordTime);
+    }
+
+    // the buffers and images share a few blocks of device memory
+    MemoryStats memoryStats = vkSetup.memoryAllocator.getStats();
+    ImGui::Text("Device memory: %zu allocations in %zu blocks, %llu / %llu MB used", memoryStats.allocationCount, memoryStats.blockCount,
+        (unsigned long long)(memoryStats.allocatedBytes >> 20), (unsigned long long)(memoryStats.blockBytes >> 20));
+    ImGui::Checkbox("Meshlet culling", &enableMeshletCulling);
+    ImGui::Text("Visible meshlets: %u / %u", visibleMeshlets, duckModel.lods[currentLod].meshletCount);
+    ImGui::Text("Draws: %u", activeDraws);
+    ImGui::Text("Materials: %zu (%u in this level)", duckModel.materials.size(), duckModel.lods[currentLod].submeshCount);
+    ImGui::Text("Level of detail: %u (%u triangles)", currentLod, duckModel.lods[currentLod].indexCount / 3);
+    ImGui::SliderInt("Forced level", &forcedLod, -1, static_cast<int>(duckModel.lods.size()) - 1);
+    ImGui::SliderFloat("Max error (pixels)", &lodErrorThreshold, 0.1f, 10.0f);
+    ImGui::End();
+
     // tell ImGui to render
     ImGui::Render();
 
@@ -900,10 +1045,11 @@ void DuckApplication::cleanup() {
     vkFreeCommandBuffers(vkSetup.device, renderCommandPool, static_cast<uint32_t>(renderCommandBuffers.size()), renderCommandBuffers.data());
     vkFreeCommandBuffers(vkSetup.device, imGuiCommandPool, static_cast<uint32_t>(imGuiCommandBuffers.size()), imGuiCommandBuffers.data());
     
-    // also destroy the uniform buffers that worked with the swap chain
+    // also destroy the uniform ring and the indirect buffers that worked with the swap chain
+    uniformRing.cleanupUniformRing();
     for (size_t i = 0; i < swapChainData.images.size(); i++) {
-        vkDestroyBuffer(vkSetup.device, uniformBuffers[i], nullptr);
-        vkFreeMemory(vkSetup.device, uniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(vkSetup.device, indirectBuffers[i], nullptr);
+        vkSetup.memoryAllocator.free(indirectBuffersMemory[i]);
     }
 
     // call the function we created for destroying the swap chain and frame buffers
@@ -915,18 +1061,26 @@ void DuckApplication::cleanup() {
     vkDestroyDescriptorPool(vkSetup.device, imGuiDescriptorPool, nullptr);
     vkDestroyDescriptorPool(vkSetup.device, descriptorPool, nullptr);
 
-    duckTexture.cleanupTexture();
+    // the uploads still in flight, before the textures and buffers they write to
+    uploadBatcher.cleanupUploadBatcher();
+
+    textureTable.removeTexture(duckTexture);
+    textureTable.cleanupTextureTable();
+    textureCache.releaseTexture(duckTexture);
+    textureCache.cleanupTextureCache();
+    // after the textures, which may still be streaming from it
+    stagingBuffer.cleanupStagingBuffer();
 
     // destroy the descriptor layout
     vkDestroyDescriptorSetLayout(vkSetup.device, descriptorSetLayout, nullptr);
 
-    // destroy the index buffer and free its memory
-    vkDestroyBuffer(vkSetup.device, indexBuffer, nullptr);
-    vkFreeMemory(vkSetup.device, indexBufferMemory, nullptr);
+    // destroy the geometry arena, with the vertices and indices of every mesh
+    geometryArena.removeMesh(duckGeometry);
+    geometryArena.cleanupGeometryArena();
 
-    // destroy the vertex buffer and free its memory
-    vkDestroyBuffer(vkSetup.device, vertexBuffer, nullptr);
-    vkFreeMemory(vkSetup.device, vertexBufferMemory, nullptr);
+    // and the material table
+    vkDestroyBuffer(vkSetup.device, materialBuffer, nullptr);
+    vkSetup.memoryAllocator.free(materialBufferMemory);
 
 
     // loop over each frame and destroy its semaphores 
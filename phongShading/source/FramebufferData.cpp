@@ -29,7 +29,7 @@ void FramebufferData::cleanupFrambufferData() {
     // destroy the depth image and related data (view and free memory)
     vkDestroyImageView(vkSetup->device, depthResource.depthImageView, nullptr);
     vkDestroyImage(vkSetup->device, depthResource.depthImage, nullptr);
-    vkFreeMemory(vkSetup->device, depthResource.depthImageMemory, nullptr);
+    vkSetup->memoryAllocator.free(depthResource.depthImageMemory);
     // then desroy the frame buffers
     for (size_t i = 0; i < framebuffers.size(); i++) {
         vkDestroyFramebuffer(vkSetup->device, framebuffers[i], nullptr);
@@ -0,0 +1,159 @@
+//
+// Geometry arena definition
+//
+
+#include <GeometryArena.h>
+
+#include <Vertex.h> // vertex streams
+#include <Utils.h> // utils namespace
+
+#include <cstring> // memcpy
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Create and destroy the arena
+//
+//////////////////////
+
+void GeometryArena::createGeometryArena(VulkanSetup* pVkSetup, StagingBuffer* pStagingBuffer, UploadBatcher* pUploadBatcher, VkDeviceSize attributeStride) {
+    vkSetup = pVkSetup;
+    stagingBuffer = pStagingBuffer;
+    uploadBatcher = pUploadBatcher;
+    this->attributeStride = attributeStride;
+
+    // each section starts on a 16 byte boundary
+    attributeOffset = (sizeof(VertexPosition) * GEOMETRY_ARENA_VERTICES + 15) & ~VkDeviceSize(15);
+    indexOffset = (attributeOffset + attributeStride * GEOMETRY_ARENA_VERTICES + 15) & ~VkDeviceSize(15);
+    VkDeviceSize bufferSize = indexOffset + sizeof(uint32_t) * GEOMETRY_ARENA_INDICES;
+
+    utils::createBuffer(&vkSetup->device, &vkSetup->memoryAllocator, bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        buffer, bufferMemory);
+
+    freeVertices = { { 0, GEOMETRY_ARENA_VERTICES } };
+    freeIndices = { { 0, GEOMETRY_ARENA_INDICES } };
+}
+
+void GeometryArena::cleanupGeometryArena() {
+    vkDestroyBuffer(vkSetup->device, buffer, nullptr);
+    vkSetup->memoryAllocator.free(bufferMemory);
+    freeVertices.clear();
+    freeIndices.clear();
+}
+
+//////////////////////
+//
+// Add and remove meshes
+//
+//////////////////////
+
+GeometryRange GeometryArena::addMesh(const Model& model) {
+    if (model.attributeStreamSize() != attributeStride * model.vertices.size()) {
+        throw std::runtime_error("failed to add mesh to the geometry arena, its vertex attributes are not in the format of the arena!");
+    }
+
+    GeometryRange range;
+    range.vertexCount = static_cast<uint32_t>(model.vertices.size());
+    range.indexCount = static_cast<uint32_t>(model.indices.size());
+    if (!allocateRange(freeVertices, range.vertexCount, range.firstVertex)) {
+        throw std::runtime_error("failed to add mesh to the geometry arena, not enough room for its vertices!");
+    }
+    if (!allocateRange(freeIndices, range.indexCount, range.firstIndex)) {
+        freeRange(freeVertices, range.firstVertex, range.vertexCount);
+        throw std::runtime_error("failed to add mesh to the geometry arena, not enough room for its indices!");
+    }
+
+    // the three parts of the mesh are written one after the other in a single staging region
+    VkDeviceSize positionSize = model.positionStreamSize();
+    VkDeviceSize attributeSize = model.attributeStreamSize();
+    VkDeviceSize indexSize = sizeof(uint32_t) * model.indices.size();
+    VkDeviceSize stagingAttributeOffset = (positionSize + 15) & ~VkDeviceSize(15);
+    VkDeviceSize stagingIndexOffset = (stagingAttributeOffset + attributeSize + 15) & ~VkDeviceSize(15);
+
+    StagingRegion staging = stagingBuffer->allocate(stagingIndexOffset + indexSize, 16);
+    model.writeVertexStreams(staging.data, staging.data + stagingAttributeOffset);
+    memcpy(staging.data + stagingIndexOffset, model.indices.data(), (size_t)indexSize);
+
+    // each part to its section of the arena
+    VkBufferCopy copyRegions[3]{};
+    copyRegions[0].srcOffset = staging.offset;
+    copyRegions[0].dstOffset = sizeof(VertexPosition) * range.firstVertex;
+    copyRegions[0].size = positionSize;
+    copyRegions[1].srcOffset = staging.offset + stagingAttributeOffset;
+    copyRegions[1].dstOffset = attributeOffset + attributeStride * range.firstVertex;
+    copyRegions[1].size = attributeSize;
+    copyRegions[2].srcOffset = staging.offset + stagingIndexOffset;
+    copyRegions[2].dstOffset = indexOffset + sizeof(uint32_t) * range.firstIndex;
+    copyRegions[2].size = indexSize;
+
+    // on the transfer queue, then each range is handed to the graphics queue. The staging region is freed once the
+    // batch is done
+    vkCmdCopyBuffer(uploadBatcher->recordTransfer(), staging.buffer, buffer, 3, copyRegions);
+    for (const VkBufferCopy& copyRegion : copyRegions) {
+        uploadBatcher->transferBufferOwnership(buffer, copyRegion.dstOffset, copyRegion.size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+    }
+    uploadBatcher->freeAfterUpload(staging);
+    return range;
+}
+
+void GeometryArena::removeMesh(GeometryRange& range) {
+    // the draws of the mesh must have completed
+    freeRange(freeVertices, range.firstVertex, range.vertexCount);
+    freeRange(freeIndices, range.firstIndex, range.indexCount);
+    range = GeometryRange{};
+}
+
+void GeometryArena::bind(VkCommandBuffer commandBuffer) const {
+    // the position and attribute streams are two sections of the buffer, a depth only pass would bind the first one only
+    VkBuffer vertexBuffers[] = { buffer, buffer };
+    VkDeviceSize offsets[] = { 0, attributeOffset };
+    vkCmdBindVertexBuffers(commandBuffer, POSITION_BINDING, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, buffer, indexOffset, VK_INDEX_TYPE_UINT32);
+}
+
+//////////////////////
+//
+// Free ranges
+//
+//////////////////////
+
+bool GeometryArena::allocateRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t count, uint32_t& first) {
+    for (auto freeRange = freeRanges.begin(); freeRange != freeRanges.end(); ++freeRange) {
+        if (freeRange->second < count) {
+            continue;
+        }
+        first = freeRange->first;
+        uint32_t remaining = freeRange->second - count;
+        freeRanges.erase(freeRange);
+        if (remaining > 0) {
+            freeRanges[first + count] = remaining;
+        }
+        return true;
+    }
+    return false;
+}
+
+void GeometryArena::freeRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t first, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // merge with the free range that follows
+    auto next = freeRanges.find(first + count);
+    if (next != freeRanges.end()) {
+        count += next->second;
+        freeRanges.erase(next);
+    }
+
+    // and with the one that ends where this one starts
+    auto inserted = freeRanges.emplace(first, count).first;
+    if (inserted != freeRanges.begin()) {
+        auto prev = std::prev(inserted);
+        if (prev->first + prev->second == first) {
+            prev->second += count;
+            freeRanges.erase(inserted);
+        }
+    }
+}
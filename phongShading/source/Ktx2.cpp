@@ -0,0 +1,247 @@
+//
+// Definition of the KTX2 texture reading and writing
+//
+
+#include <Ktx2.h>
+
+#include <algorithm> // max
+#include <cstring> // memcpy, memcmp
+#include <fstream> // file input and output
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Formats
+//
+//////////////////////
+
+bool ktx2::isSupportedFormat(VkFormat format) {
+    return blockSize(format) != 0;
+}
+
+uint32_t ktx2::blockSize(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+VkDeviceSize ktx2::levelSize(VkFormat format, uint32_t width, uint32_t height) {
+    VkDeviceSize blocksWide = (width + KTX2_BLOCK_DIMENSION - 1) / KTX2_BLOCK_DIMENSION;
+    VkDeviceSize blocksHigh = (height + KTX2_BLOCK_DIMENSION - 1) / KTX2_BLOCK_DIMENSION;
+    return blocksWide * blocksHigh * blockSize(format);
+}
+
+//////////////////////
+//
+// Reading
+//
+//////////////////////
+
+void ktx2::loadKtx2(const std::string& path, Ktx2Texture& texture) {
+    loadKtx2(path, texture, [&texture](VkDeviceSize size) {
+        texture.data.resize(static_cast<size_t>(size));
+        return texture.data.data();
+    });
+}
+
+void ktx2::loadKtx2(const std::string& path, Ktx2Texture& texture, const std::function<uint8_t*(VkDeviceSize size)>& allocateData) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open ktx2 file " + path + "!");
+    }
+    uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    // the header, checked field by field
+    Ktx2Header header{};
+    if (fileSize < sizeof(Ktx2Header) || !file.read(reinterpret_cast<char*>(&header), sizeof(Ktx2Header))
+        || memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error("failed to read ktx2 file " + path + ", not a ktx2 file!");
+    }
+
+    VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    if (!isSupportedFormat(format)) {
+        throw std::runtime_error("failed to read ktx2 file " + path + ", the format is not BC1, BC3 or BC7!");
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount != 0 || header.faceCount != 1) {
+        throw std::runtime_error("failed to read ktx2 file " + path + ", only single 2D images are supported!");
+    }
+    if (header.supercompressionScheme != 0) {
+        throw std::runtime_error("failed to read ktx2 file " + path + ", supercompressed files are not supported!");
+    }
+
+    // a chain longer than the full one would have levels below 1x1
+    uint32_t fullLevelCount = 1;
+    for (uint32_t size = std::max(header.pixelWidth, header.pixelHeight); size > 1; size >>= 1) {
+        fullLevelCount++;
+    }
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    if (levelCount > fullLevelCount) {
+        throw std::runtime_error("failed to read ktx2 file " + path + ", too many levels!");
+    }
+
+    // the level index follows the header
+    std::vector<Ktx2LevelIndex> levelIndex(levelCount);
+    if (!file.read(reinterpret_cast<char*>(levelIndex.data()), levelCount * sizeof(Ktx2LevelIndex))) {
+        throw std::runtime_error("failed to read ktx2 file " + path + ", truncated level index!");
+    }
+
+    texture.format = format;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.levelCount = levelCount;
+    texture.levelOffsets.resize(levelCount);
+
+    // the levels are stored from the smallest in the file, they are packed from the largest here which is the order of
+    // the copy regions. Every level size is a multiple of the block size so the offsets stay aligned for the copies
+    VkDeviceSize dataSize = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        VkDeviceSize expectedSize = levelSize(format, std::max(header.pixelWidth >> level, 1u), std::max(header.pixelHeight >> level, 1u));
+        const Ktx2LevelIndex& index = levelIndex[level];
+        // a truncated file must not be read past its end
+        if (index.byteLength != expectedSize || index.byteOffset > fileSize || index.byteLength > fileSize - index.byteOffset) {
+            throw std::runtime_error("failed to read ktx2 file " + path + ", bad level " + std::to_string(level) + "!");
+        }
+        texture.levelOffsets[level] = dataSize;
+        dataSize += expectedSize;
+    }
+
+    uint8_t* data = allocateData(dataSize);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        file.seekg(static_cast<std::streamoff>(levelIndex[level].byteOffset));
+        if (!file.read(reinterpret_cast<char*>(data + texture.levelOffsets[level]), static_cast<std::streamsize>(levelIndex[level].byteLength))) {
+            throw std::runtime_error("failed to read ktx2 file " + path + ", truncated level " + std::to_string(level) + "!");
+        }
+    }
+}
+
+//////////////////////
+//
+// Writing
+//
+//////////////////////
+
+// the basic data format descriptor of a block compressed format: one descriptor block with a sample per 64 bits of
+// the block, the colour model being the compression scheme (from the Khronos data format specification)
+static std::vector<uint32_t> makeDataFormatDescriptor(VkFormat format) {
+    // khr_df_model_e and khr_df_transfer_e values
+    const uint32_t MODEL_BC1A = 128, MODEL_BC3 = 130, MODEL_BC7 = 134;
+    const uint32_t TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2;
+    const uint32_t PRIMARIES_BT709 = 1;
+
+    uint32_t model = MODEL_BC7;
+    bool srgb = false;
+    // the channel of each sample, the bc3 alpha is in the first 64 bits of the block and its colour in the last 64
+    std::vector<uint32_t> channels;
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        srgb = true;
+        [[fallthrough]];
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        model = MODEL_BC1A;
+        channels = { 0 }; // colour
+        break;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        srgb = true;
+        [[fallthrough]];
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        model = MODEL_BC1A;
+        channels = { 1 }; // alpha present
+        break;
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        srgb = true;
+        [[fallthrough]];
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+        model = MODEL_BC3;
+        channels = { 15, 0 }; // alpha, colour
+        break;
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        srgb = true;
+        [[fallthrough]];
+    default:
+        model = MODEL_BC7;
+        channels = { 0 }; // colour
+        break;
+    }
+
+    uint32_t blockBytes = ktx2::blockSize(format);
+    uint32_t descriptorBlockSize = 24 + 16 * static_cast<uint32_t>(channels.size());
+    std::vector<uint32_t> words;
+    words.push_back(4 + descriptorBlockSize); // total size, including this word
+    words.push_back(0); // vendor id and descriptor type, both khronos basic
+    words.push_back(2 | (descriptorBlockSize << 16)); // version 1.3 of the specification
+    words.push_back(model | (PRIMARIES_BT709 << 8) | ((srgb ? TRANSFER_SRGB : TRANSFER_LINEAR) << 16)); // flags 0, straight alpha
+    words.push_back((KTX2_BLOCK_DIMENSION - 1) | ((KTX2_BLOCK_DIMENSION - 1) << 8)); // 4x4x1x1 texel blocks, stored minus one
+    words.push_back(blockBytes); // bytes in plane 0
+    words.push_back(0); // bytes in planes 4 to 7
+    for (size_t sample = 0; sample < channels.size(); sample++) {
+        // bit offset, bit length minus one and channel type, then position, lower and upper
+        words.push_back(static_cast<uint32_t>(64 * sample) | (63u << 16) | (channels[sample] << 24));
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(UINT32_MAX);
+    }
+    return words;
+}
+
+void ktx2::writeKtx2(const std::string& path, const Ktx2Texture& texture) {
+    if (!isSupportedFormat(texture.format)) {
+        throw std::runtime_error("failed to write ktx2 file " + path + ", the format is not BC1, BC3 or BC7!");
+    }
+    std::vector<uint32_t> descriptor = makeDataFormatDescriptor(texture.format);
+
+    Ktx2Header header{};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = static_cast<uint32_t>(texture.format);
+    header.typeSize = 1; // block compressed data has no endianness
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.pixelDepth = 0;
+    header.layerCount = 0;
+    header.faceCount = 1;
+    header.levelCount = texture.levelCount;
+    header.supercompressionScheme = 0;
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + texture.levelCount * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+    // the levels go after the descriptor from the smallest, each aligned on the block size which is a multiple of 4
+    uint64_t alignment = blockSize(texture.format);
+    std::vector<Ktx2LevelIndex> levelIndex(texture.levelCount);
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (uint32_t level = texture.levelCount; level-- > 0;) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        VkDeviceSize end = level + 1 < texture.levelCount ? texture.levelOffsets[level + 1] : texture.data.size();
+        levelIndex[level].byteOffset = offset;
+        levelIndex[level].byteLength = end - texture.levelOffsets[level];
+        levelIndex[level].uncompressedByteLength = levelIndex[level].byteLength;
+        offset += levelIndex[level].byteLength;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open ktx2 file " + path + " for writing!");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+    file.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+    file.write(reinterpret_cast<const char*>(descriptor.data()), descriptor.size() * sizeof(uint32_t));
+    for (uint32_t level = texture.levelCount; level-- > 0;) {
+        // the padding up to the level
+        static const char zeros[16] = {};
+        file.write(zeros, static_cast<std::streamsize>(levelIndex[level].byteOffset - (uint64_t)file.tellp()));
+        file.write(reinterpret_cast<const char*>(texture.data.data() + texture.levelOffsets[level]), static_cast<std::streamsize>(levelIndex[level].byteLength));
+    }
+    if (!file) {
+        throw std::runtime_error("failed to write ktx2 file " + path + "!");
+    }
+}
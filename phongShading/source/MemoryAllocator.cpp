@@ -0,0 +1,389 @@
+//
+// Memory allocator definition
+//
+
+#include <MemoryAllocator.h>
+
+#include <algorithm> // max, min, count_if
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Bit scans
+//
+//////////////////////
+
+// the index of the highest set bit of a non zero value
+static uint32_t highestBit(uint64_t value) {
+    uint32_t bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+// the index of the lowest set bit of a non zero value
+static uint32_t lowestBit(uint64_t value) {
+    uint32_t bit = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+//////////////////////
+//
+// Create and destroy the allocator
+//
+//////////////////////
+
+void MemoryAllocator::createMemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice) {
+    this->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+
+    pools.resize(2 * memoryProperties.memoryTypeCount);
+    for (size_t i = 0; i < pools.size(); i++) {
+        pools[i].memoryType = static_cast<uint32_t>(i / 2);
+        pools[i].flBitmap = 0;
+        std::fill(std::begin(pools[i].slBitmaps), std::end(pools[i].slBitmaps), 0u);
+        for (auto& heads : pools[i].heads) {
+            std::fill(std::begin(heads), std::end(heads), NO_REGION);
+        }
+    }
+}
+
+void MemoryAllocator::cleanupMemoryAllocator() {
+    for (auto& pool : pools) {
+        for (auto& block : pool.blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                destroyBlock(block);
+            }
+        }
+    }
+    pools.clear();
+    regions.clear();
+    unusedRegions.clear();
+}
+
+uint32_t MemoryAllocator::createBlock(Pool& pool, VkDeviceSize size) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = pool.memoryType;
+
+    Block block;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory block!");
+    }
+    block.size = size;
+
+    // host visible blocks are mapped once for their lifetime, the allocations are written through their mapped pointer
+    if (memoryProperties.memoryTypes[pool.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* mapped;
+        if (vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            vkFreeMemory(device, block.memory, nullptr);
+            throw std::runtime_error("failed to map device memory block!");
+        }
+        block.mapped = static_cast<uint8_t*>(mapped);
+    }
+
+    // in the slot of a released block if there is one
+    uint32_t blockIndex = 0;
+    for (; blockIndex < pool.blocks.size() && pool.blocks[blockIndex].memory != VK_NULL_HANDLE; blockIndex++);
+    if (blockIndex == pool.blocks.size()) {
+        pool.blocks.emplace_back();
+    }
+    pool.blocks[blockIndex] = block;
+
+    // the whole block is a single free region
+    uint32_t region = newRegion();
+    regions[region].offset = 0;
+    regions[region].size = size;
+    regions[region].block = blockIndex;
+    insertFreeRegion(pool, region);
+    return region;
+}
+
+void MemoryAllocator::destroyBlock(Block& block) {
+    if (block.mapped != nullptr) {
+        vkUnmapMemory(device, block.memory);
+    }
+    vkFreeMemory(device, block.memory, nullptr);
+    block = Block{};
+}
+
+//////////////////////
+//
+// Allocate and free
+//
+//////////////////////
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear) {
+    // the first memory type with the properties, as utils::findMemoryType picks it
+    uint32_t memoryType = 0;
+    for (; memoryType < memoryProperties.memoryTypeCount; memoryType++) {
+        if ((requirements.memoryTypeBits & (1 << memoryType)) && (memoryProperties.memoryTypes[memoryType].propertyFlags & properties) == properties) {
+            break;
+        }
+    }
+    if (memoryType == memoryProperties.memoryTypeCount) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    // optimal images only share blocks with linear resources if there is no granularity to honour between them
+    uint32_t poolIndex = 2 * memoryType + (!linear && bufferImageGranularity > 1 ? 1 : 0);
+    VkDeviceSize alignment = std::max(requirements.alignment, VkDeviceSize(1));
+    // large enough for the region to be aligned wherever it starts
+    VkDeviceSize searchSize = requirements.size + alignment - 1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Pool& pool = pools[poolIndex];
+
+    uint32_t region = findFreeRegion(pool, searchSize);
+    if (region == NO_REGION) {
+        // the blocks of small heaps are smaller so that one block doesn't take up the whole heap
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        VkDeviceSize blockSize = std::min(MEMORY_BLOCK_SIZE, heapSize / 8);
+        // the region of the new block is taken directly. Searching again rounds searchSize up to the next size class,
+        // while a block of exactly searchSize sits in the class below it
+        region = createBlock(pool, std::max(blockSize, searchSize));
+    }
+    if (region == NO_REGION) {
+        throw std::runtime_error("failed to allocate device memory, no free region is large enough!");
+    }
+    removeFreeRegion(pool, region);
+
+    // the space before the aligned offset and after the allocation go back to the free lists
+    VkDeviceSize alignedOffset = alignUp(regions[region].offset, alignment);
+    if (alignedOffset > regions[region].offset) {
+        uint32_t padding = region;
+        region = splitRegion(padding, alignedOffset - regions[padding].offset);
+        insertFreeRegion(pool, padding);
+    }
+    if (regions[region].size > requirements.size) {
+        insertFreeRegion(pool, splitRegion(region, requirements.size));
+    }
+
+    Region& allocated = regions[region];
+    allocated.free = false;
+    Block& block = pool.blocks[allocated.block];
+    block.usedRegions++;
+
+    MemoryAllocation allocation;
+    allocation.memory = block.memory;
+    allocation.offset = allocated.offset;
+    allocation.size = allocated.size;
+    allocation.mapped = block.mapped != nullptr ? block.mapped + allocated.offset : nullptr;
+    allocation.pool = poolIndex;
+    allocation.region = region;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Pool& pool = pools[allocation.pool];
+    uint32_t region = allocation.region;
+    regions[region].free = true;
+    uint32_t blockIndex = regions[region].block;
+
+    // merge with the free neighbours so that free regions never follow each other
+    uint32_t next = regions[region].nextPhysical;
+    if (next != NO_REGION && regions[next].free) {
+        removeFreeRegion(pool, next);
+        regions[region].size += regions[next].size;
+        regions[region].nextPhysical = regions[next].nextPhysical;
+        if (regions[next].nextPhysical != NO_REGION) {
+            regions[regions[next].nextPhysical].prevPhysical = region;
+        }
+        deleteRegion(next);
+    }
+    uint32_t prev = regions[region].prevPhysical;
+    if (prev != NO_REGION && regions[prev].free) {
+        removeFreeRegion(pool, prev);
+        regions[prev].size += regions[region].size;
+        regions[prev].nextPhysical = regions[region].nextPhysical;
+        if (regions[region].nextPhysical != NO_REGION) {
+            regions[regions[region].nextPhysical].prevPhysical = prev;
+        }
+        deleteRegion(region);
+        region = prev;
+    }
+
+    // an empty block is released, unless it is the only one left so that the next allocation doesn't create it again
+    Block& block = pool.blocks[blockIndex];
+    size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const Block& b) { return b.memory != VK_NULL_HANDLE; });
+    if (--block.usedRegions == 0 && liveBlocks > 1) {
+        deleteRegion(region);
+        destroyBlock(block);
+    }
+    else {
+        insertFreeRegion(pool, region);
+    }
+    allocation = MemoryAllocation{};
+}
+
+MemoryStats MemoryAllocator::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryStats stats;
+    for (const auto& pool : pools) {
+        for (const auto& block : pool.blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                stats.blockCount++;
+                stats.blockBytes += block.size;
+                stats.allocationCount += block.usedRegions;
+            }
+        }
+    }
+    for (const auto& region : regions) {
+        if (!region.free) {
+            stats.allocatedBytes += region.size;
+        }
+    }
+    return stats;
+}
+
+//////////////////////
+//
+// Free lists
+//
+//////////////////////
+
+void MemoryAllocator::mappingInsert(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+    if (size < SMALL_SIZE) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size / (SMALL_SIZE / SL_COUNT));
+    }
+    else {
+        // the bits after the highest one pick the second level
+        uint32_t bit = highestBit(size);
+        sl = static_cast<uint32_t>(size >> (bit - SL_LOG2)) ^ SL_COUNT;
+        fl = bit - FL_SHIFT + 1;
+    }
+}
+
+void MemoryAllocator::mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+    // rounded up to the next size class, every region of the lists from there on is large enough
+    if (size < SMALL_SIZE) {
+        size = alignUp(size, SMALL_SIZE / SL_COUNT);
+    }
+    else {
+        size += (VkDeviceSize(1) << (highestBit(size) - SL_LOG2)) - 1;
+    }
+    mappingInsert(size, fl, sl);
+}
+
+uint32_t MemoryAllocator::findFreeRegion(Pool& pool, VkDeviceSize size) {
+    uint32_t fl, sl;
+    mappingSearch(size, fl, sl);
+    if (fl >= FL_COUNT) {
+        return NO_REGION;
+    }
+
+    // a list of the same power of two with large enough regions, otherwise the first list of a larger power of two
+    uint32_t slMap = sl < SL_COUNT ? pool.slBitmaps[fl] & (~0u << sl) : 0;
+    if (slMap == 0) {
+        uint64_t flMap = fl + 1 < 64 ? pool.flBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0) {
+            return NO_REGION;
+        }
+        fl = lowestBit(flMap);
+        slMap = pool.slBitmaps[fl];
+    }
+    sl = lowestBit(slMap);
+    return pool.heads[fl][sl];
+}
+
+void MemoryAllocator::insertFreeRegion(Pool& pool, uint32_t region) {
+    uint32_t fl, sl;
+    mappingInsert(regions[region].size, fl, sl);
+
+    regions[region].free = true;
+    regions[region].prevFree = NO_REGION;
+    regions[region].nextFree = pool.heads[fl][sl];
+    if (pool.heads[fl][sl] != NO_REGION) {
+        regions[pool.heads[fl][sl]].prevFree = region;
+    }
+    pool.heads[fl][sl] = region;
+    pool.flBitmap |= 1ull << fl;
+    pool.slBitmaps[fl] |= 1u << sl;
+}
+
+void MemoryAllocator::removeFreeRegion(Pool& pool, uint32_t region) {
+    uint32_t fl, sl;
+    mappingInsert(regions[region].size, fl, sl);
+
+    uint32_t prev = regions[region].prevFree;
+    uint32_t next = regions[region].nextFree;
+    if (prev != NO_REGION) {
+        regions[prev].nextFree = next;
+    }
+    else {
+        pool.heads[fl][sl] = next;
+    }
+    if (next != NO_REGION) {
+        regions[next].prevFree = prev;
+    }
+
+    // the list is empty now
+    if (pool.heads[fl][sl] == NO_REGION) {
+        pool.slBitmaps[fl] &= ~(1u << sl);
+        if (pool.slBitmaps[fl] == 0) {
+            pool.flBitmap &= ~(1ull << fl);
+        }
+    }
+    regions[region].prevFree = NO_REGION;
+    regions[region].nextFree = NO_REGION;
+}
+
+//////////////////////
+//
+// Regions
+//
+//////////////////////
+
+uint32_t MemoryAllocator::newRegion() {
+    if (!unusedRegions.empty()) {
+        uint32_t region = unusedRegions.back();
+        unusedRegions.pop_back();
+        regions[region] = Region{};
+        return region;
+    }
+    regions.emplace_back();
+    return static_cast<uint32_t>(regions.size() - 1);
+}
+
+void MemoryAllocator::deleteRegion(uint32_t region) {
+    // kept free so that it doesn't count as allocated memory
+    regions[region] = Region{};
+    unusedRegions.push_back(region);
+}
+
+uint32_t MemoryAllocator::splitRegion(uint32_t region, VkDeviceSize offset) {
+    // the new record may move the others
+    uint32_t second = newRegion();
+    Region& first = regions[region];
+    regions[second].offset = first.offset + offset;
+    regions[second].size = first.size - offset;
+    regions[second].block = first.block;
+    regions[second].prevPhysical = region;
+    regions[second].nextPhysical = first.nextPhysical;
+    if (first.nextPhysical != NO_REGION) {
+        regions[first.nextPhysical].prevPhysical = second;
+    }
+    first.size = offset;
+    first.nextPhysical = second;
+    return second;
+}
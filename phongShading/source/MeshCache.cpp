@@ -0,0 +1,263 @@
+//
+// Definition of the mesh cache
+//
+
+#include <MeshCache.h>
+
+#include <algorithm> // min
+#include <cstring> // memcpy, memcmp
+#include <fstream> // file output
+#include <filesystem> // file size, modification time, renaming
+
+// memory mapping is platform specific
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// bits of MeshCacheHeader::flags
+const uint32_t MESH_CACHE_FLAG_FETCH_OPTIMISED   = 1 << 0;
+const uint32_t MESH_CACHE_FLAG_LODS              = 1 << 1;
+const uint32_t MESH_CACHE_FLAG_RECOMPUTE_NORMALS = 1 << 2;
+
+//////////////////////
+//
+// Reading and writing
+//
+//////////////////////
+
+bool MeshCache::readCache(const std::string& path, Model& model) {
+    // the key the cache must match
+    MeshCacheHeader expected{};
+    if (!makeKey(path, model, expected)) {
+        return false;
+    }
+
+    size_t size = 0;
+    const void* data = mapFile(path + MESH_CACHE_EXTENSION, size);
+    if (data == nullptr) {
+        return false;
+    }
+
+    // the header may not be aligned in the mapping on every platform, so copy it out
+    MeshCacheHeader header{};
+    bool valid = size >= sizeof(MeshCacheHeader);
+    if (valid) {
+        memcpy(&header, data, sizeof(MeshCacheHeader));
+        valid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0
+            && header.version        == MESH_CACHE_VERSION
+            && header.sourcePathHash == expected.sourcePathHash
+            && header.sourceSize     == expected.sourceSize
+            && header.sourceModified == expected.sourceModified
+            && header.vertexStride   == expected.vertexStride
+            && header.flags          == expected.flags
+            // a truncated or corrupt file (eg a crash while writing) must not be read past its end, the counts are checked
+            // against the room left after each offset so that a huge count can't wrap the end of the block around
+            && header.vertexOffset   <= size && header.vertexCount   <= (size - header.vertexOffset)   / sizeof(Vertex)
+            && header.indexOffset    <= size && header.indexCount    <= (size - header.indexOffset)    / sizeof(uint32_t)
+            && header.submeshOffset  <= size && header.submeshCount  <= (size - header.submeshOffset)  / sizeof(Submesh)
+            && header.materialOffset <= size && header.materialCount <= (size - header.materialOffset) / sizeof(Material)
+            && header.lodCount >= 1 && header.lodCount <= MODEL_MAX_LODS
+            && header.materialCount >= 1;
+    }
+
+    // every level must be inside the index and submesh blocks
+    for (uint32_t l = 0; valid && l < header.lodCount; l++) {
+        valid = (uint64_t)header.lods[l].firstIndex + header.lods[l].indexCount <= header.indexCount
+            && (uint64_t)header.lods[l].firstSubmesh + header.lods[l].submeshCount <= header.submeshCount;
+    }
+
+    // and every submesh inside the index block, with a material from the table
+    const char* bytes = static_cast<const char*>(data);
+    for (uint64_t s = 0; valid && s < header.submeshCount; s++) {
+        Submesh submesh;
+        memcpy(&submesh, bytes + header.submeshOffset + s * sizeof(Submesh), sizeof(Submesh));
+        valid = (uint64_t)submesh.firstIndex + submesh.indexCount <= header.indexCount && submesh.materialIndex < header.materialCount;
+    }
+
+    // and every index refers to a vertex, the meshlet builder and the vertex upload index the vertices with them
+    for (uint64_t i = 0; valid && i < header.indexCount; i++) {
+        uint32_t index;
+        memcpy(&index, bytes + header.indexOffset + i * sizeof(uint32_t), sizeof(uint32_t));
+        valid = index < header.vertexCount;
+    }
+
+    if (valid) {
+        // the blocks are already in their final layout, so this is a straight copy with no parsing at all. The copy is
+        // not free, every block is read once more than if the loader and the staging writes used the mapping directly,
+        // but the model keeps its data in vectors that the meshlet builder, the stream writer and the UI read after
+        // loading, so the mapping is released here rather than kept alive with the model
+        const Vertex* vertexBlock = reinterpret_cast<const Vertex*>(bytes + header.vertexOffset);
+        const uint32_t* indexBlock = reinterpret_cast<const uint32_t*>(bytes + header.indexOffset);
+        const Submesh* submeshBlock = reinterpret_cast<const Submesh*>(bytes + header.submeshOffset);
+        const Material* materialBlock = reinterpret_cast<const Material*>(bytes + header.materialOffset);
+        model.vertices.assign(vertexBlock, vertexBlock + header.vertexCount);
+        model.indices.assign(indexBlock, indexBlock + header.indexCount);
+        model.submeshes.assign(submeshBlock, submeshBlock + header.submeshCount);
+        model.materials.assign(materialBlock, materialBlock + header.materialCount);
+
+        model.bounds = header.bounds;
+        model.centreOfGravity = header.bounds.centroid;
+        model.modelSpan = 2.0f * header.bounds.sphereRadius;
+        model.stats = header.stats;
+        model.lods.assign(header.lods, header.lods + header.lodCount);
+    }
+
+    unmapFile(data, size);
+    return valid;
+}
+
+bool MeshCache::writeCache(const std::string& path, const Model& model) {
+    MeshCacheHeader header{};
+    if (!makeKey(path, model, header)) {
+        return false;
+    }
+
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+
+    header.bounds = model.bounds;
+    header.stats = model.stats;
+
+    header.lodCount = static_cast<uint32_t>(std::min(model.lods.size(), (size_t)MODEL_MAX_LODS));
+    for (uint32_t l = 0; l < header.lodCount; l++) {
+        header.lods[l] = model.lods[l];
+    }
+
+    // lay out the blocks one after the other, each aligned
+    auto align = [](uint64_t offset) { return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1); };
+    header.vertexCount = model.vertices.size();
+    header.vertexOffset = align(sizeof(MeshCacheHeader));
+    header.indexCount = model.indices.size();
+    header.indexOffset = align(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+    header.submeshCount = model.submeshes.size();
+    header.submeshOffset = align(header.indexOffset + header.indexCount * sizeof(uint32_t));
+    header.materialCount = model.materials.size();
+    header.materialOffset = align(header.submeshOffset + header.submeshCount * sizeof(Submesh));
+
+    // write to a temporary file and rename it once complete, so that a reader never sees a partial cache
+    std::string cachePath = path + MESH_CACHE_EXTENSION;
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        const char padding[MESH_CACHE_ALIGNMENT] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+        file.write(padding, header.vertexOffset - sizeof(MeshCacheHeader));
+        file.write(reinterpret_cast<const char*>(model.vertices.data()), header.vertexCount * sizeof(Vertex));
+        file.write(padding, header.indexOffset - (header.vertexOffset + header.vertexCount * sizeof(Vertex)));
+        file.write(reinterpret_cast<const char*>(model.indices.data()), header.indexCount * sizeof(uint32_t));
+        file.write(padding, header.submeshOffset - (header.indexOffset + header.indexCount * sizeof(uint32_t)));
+        file.write(reinterpret_cast<const char*>(model.submeshes.data()), header.submeshCount * sizeof(Submesh));
+        file.write(padding, header.materialOffset - (header.submeshOffset + header.submeshCount * sizeof(Submesh)));
+        file.write(reinterpret_cast<const char*>(model.materials.data()), header.materialCount * sizeof(Material));
+
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    return !error;
+}
+
+bool MeshCache::makeKey(const std::string& path, const Model& model, MeshCacheHeader& header) {
+    std::error_code error;
+    std::filesystem::path sourcePath = std::filesystem::absolute(path, error);
+    if (error) {
+        return false;
+    }
+
+    // the size and modification time change whenever the source is edited
+    header.sourceSize = std::filesystem::file_size(sourcePath, error);
+    if (error) {
+        return false;
+    }
+    header.sourceModified = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    if (error) {
+        return false;
+    }
+
+    // 64 bit FNV-1a hash of the absolute path
+    header.sourcePathHash = 0xcbf29ce484222325ull;
+    for (char c : sourcePath.string()) {
+        header.sourcePathHash ^= static_cast<unsigned char>(c);
+        header.sourcePathHash *= 0x100000001b3ull;
+    }
+
+    // the data also depends on the vertex layout and the processing applied when loading
+    header.vertexStride = sizeof(Vertex);
+    header.flags = (model.enableVertexFetchOptimisation ? MESH_CACHE_FLAG_FETCH_OPTIMISED : 0)
+                 | (model.enableLods ? MESH_CACHE_FLAG_LODS : 0)
+                 | (model.recomputeNormals ? MESH_CACHE_FLAG_RECOMPUTE_NORMALS : 0);
+    return true;
+}
+
+//////////////////////
+//
+// Memory mapping
+//
+//////////////////////
+
+const void* MeshCache::mapFile(const std::string& path, size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // the view keeps the mapping and the file alive, so both handles can be closed straight away
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return data;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return nullptr;
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(file);
+        return nullptr;
+    }
+    size = static_cast<size_t>(fileStat.st_size);
+
+    // the mapping stays valid after closing the file descriptor
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    return data == MAP_FAILED ? nullptr : data;
+#endif
+}
+
+void MeshCache::unmapFile(const void* data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<void*>(data), size);
+#endif
+}
@@ -0,0 +1,315 @@
+//
+// Definition of the mesh processing passes
+//
+
+#include <MeshUtils.h>
+
+#include <Parallel.h> // parallelFor
+
+#include <cstring> // memcpy, memcmp
+#include <algorithm> // min, max
+
+//////////////////////
+//
+// Vertex welding
+//
+//////////////////////
+
+void VertexWelder::initWelder(size_t maxVertices) {
+    // keep the load factor of the table under 2/3 even if every vertex is unique, linear probing degrades quickly above that
+    size_t capacity = 16;
+    while (capacity < maxVertices + maxVertices / 2) {
+        capacity <<= 1;
+    }
+
+    slots.assign(capacity, EMPTY_SLOT);
+    mask = static_cast<uint32_t>(capacity - 1);
+}
+
+uint32_t VertexWelder::insertVertex(const Vertex& vertex, std::vector<Vertex>& vertices) {
+    // probe linearly from the hashed slot until we find either an identical vertex or an empty slot
+    uint32_t slot = hashVertex(vertex) & mask;
+    while (slots[slot] != EMPTY_SLOT) {
+        // vertices are compared bit for bit, so only exact duplicates are welded together
+        if (memcmp(&vertices[slots[slot]], &vertex, sizeof(Vertex)) == 0) {
+            return slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // first time we see this vertex, so add it to the unique vertices
+    slots[slot] = static_cast<uint32_t>(vertices.size());
+    vertices.push_back(vertex);
+    return slots[slot];
+}
+
+uint32_t VertexWelder::hashVertex(const Vertex& vertex) {
+    // the vertex is made of 32 bit floats only, so hash it as an array of words (murmur3 style mixing)
+    uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+    memcpy(words, &vertex, sizeof(Vertex));
+
+    uint32_t hash = 0x9747b28c;
+    for (uint32_t word : words) {
+        word *= 0xcc9e2d51;
+        word = (word << 15) | (word >> 17);
+        word *= 0x1b873593;
+        hash ^= word;
+        hash = (hash << 13) | (hash >> 19);
+        hash = hash * 5 + 0xe6546b64;
+    }
+
+    // final avalanche so that the low bits used by the mask depend on every input bit
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+//////////////////////
+//
+// Post-transform vertex cache
+//
+//////////////////////
+
+float meshutils::computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+    if (indices.empty()) {
+        return 0.0f;
+    }
+
+    // simulate a fifo cache using time stamps: a vertex is in the cache if fewer than cacheSize misses happened since it was
+    // last loaded. Start the stamps far enough in the past that every vertex is initially a miss
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    uint32_t misses = 0;
+    uint32_t time = cacheSize + 1;
+
+    for (uint32_t index : indices) {
+        if (time - cacheTime[index] > cacheSize) {
+            cacheTime[index] = time++;
+            misses++;
+        }
+    }
+
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+void meshutils::optimiseVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    //
+    // build the vertex -> triangle adjacency in compressed form (offsets into a single array)
+    //
+
+    // number of triangles that use each vertex and have not been emitted yet
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices) {
+        liveTriangles[index]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    //
+    // tipsify: fan around a vertex, then move on to the best candidate still in the cache
+    //
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0); // time stamp at which each vertex entered the cache
+    std::vector<bool> emitted(triangleCount, false);  // whether each triangle was already output
+    std::vector<uint32_t> deadEndStack;               // recently used vertices, to recover from dead ends
+    std::vector<uint32_t> candidates;                 // vertices of the triangles emitted in the last fan
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0; // next vertex to try in input order when the dead end stack runs dry
+    int64_t fanningVertex = 0;
+
+    while (fanningVertex >= 0) {
+        candidates.clear();
+
+        // emit every live triangle around the fanning vertex
+        for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; a++) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t v = indices[3 * triangle + corner];
+                output.push_back(v);
+                deadEndStack.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                // the vertex enters the cache if it was not already in it
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // pick the candidate with live triangles that will still be in the cache once they are all emitted, oldest first
+        fanningVertex = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanningVertex = v;
+            }
+        }
+
+        if (fanningVertex >= 0) {
+            continue;
+        }
+
+        // dead end, first try the most recently used vertices
+        while (!deadEndStack.empty()) {
+            uint32_t v = deadEndStack.back();
+            deadEndStack.pop_back();
+            if (liveTriangles[v] > 0) {
+                fanningVertex = v;
+                break;
+            }
+        }
+
+        // then carry on through the vertices in input order
+        while (fanningVertex < 0 && cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                fanningVertex = static_cast<int64_t>(cursor);
+            }
+            cursor++;
+        }
+    }
+
+    indices.swap(output);
+}
+
+//////////////////////
+//
+// Vertex fetch
+//
+//////////////////////
+
+size_t meshutils::computeFetchMisses(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexStride, uint32_t lineSize, uint32_t cacheLines) {
+    // same time stamp fifo as for the post-transform cache, but over the memory lines of the vertex buffer
+    size_t lineCount = (vertexCount * vertexStride + lineSize - 1) / lineSize;
+    std::vector<uint32_t> cacheTime(lineCount, 0);
+    size_t misses = 0;
+    uint32_t time = cacheLines + 1;
+
+    for (uint32_t index : indices) {
+        // a vertex may straddle two lines
+        size_t firstLine = (index * vertexStride) / lineSize;
+        size_t lastLine = (index * vertexStride + vertexStride - 1) / lineSize;
+        for (size_t line = firstLine; line <= lastLine; line++) {
+            if (time - cacheTime[line] > cacheLines) {
+                cacheTime[line] = time++;
+                misses++;
+            }
+        }
+    }
+
+    return misses;
+}
+
+void meshutils::optimiseVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    // new position of each vertex, assigned when the vertex is first referenced
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
+
+//////////////////////
+//
+// Normals
+//
+//////////////////////
+
+// the face normals summed by one worker, over the positions from first to first + sums.size()
+struct NormalAccumulator {
+    uint32_t first = 0;
+    std::vector<glm::vec3> sums;
+};
+
+std::vector<glm::vec3> meshutils::generateNormals(const std::vector<float>& positions, const std::vector<uint32_t>& positionIndices) {
+    size_t positionCount = positions.size() / 3;
+    size_t triangleCount = positionIndices.size() / 3;
+
+    auto position = [&](uint32_t p) { return glm::vec3(positions[3 * p + 0], positions[3 * p + 1], positions[3 * p + 2]); };
+
+    // the triangles of a range mostly use nearby positions, so a buffer covering only the range of positions a worker
+    // touches is far smaller than a copy of all the normals per worker
+    std::vector<NormalAccumulator> accumulators(parallel::workerCount());
+    parallel::parallelFor(triangleCount, [&](size_t begin, size_t end, uint32_t worker) {
+        uint32_t first = UINT32_MAX, last = 0;
+        for (size_t i = 3 * begin; i < 3 * end; i++) {
+            first = std::min(first, positionIndices[i]);
+            last = std::max(last, positionIndices[i]);
+        }
+        if (first > last) {
+            return;
+        }
+
+        NormalAccumulator& accumulator = accumulators[worker];
+        accumulator.first = first;
+        accumulator.sums.assign(last - first + 1, glm::vec3(0.0f));
+
+        for (size_t t = begin; t < end; t++) {
+            const uint32_t* triangle = &positionIndices[3 * t];
+            glm::vec3 a = position(triangle[0]);
+            glm::vec3 b = position(triangle[1]);
+            glm::vec3 c = position(triangle[2]);
+            // the length of the cross product is twice the area of the triangle, so adding them up weighs by area
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                accumulator.sums[triangle[corner] - first] += normal;
+            }
+        }
+    });
+
+    // the reduction, always in worker order so that the result does not depend on the timing of the workers
+    std::vector<glm::vec3> normals(positionCount);
+    parallel::parallelFor(positionCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t p = begin; p < end; p++) {
+            glm::vec3 sum = glm::vec3(0.0f);
+            for (const auto& accumulator : accumulators) {
+                if (p >= accumulator.first && p - accumulator.first < accumulator.sums.size()) {
+                    sum += accumulator.sums[p - accumulator.first];
+                }
+            }
+            float length = glm::length(sum);
+            normals[p] = length > 0.0f ? sum / length : glm::vec3(0.0f);
+        }
+    });
+
+    return normals;
+}
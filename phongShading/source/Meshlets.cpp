@@ -0,0 +1,195 @@
+//
+// Definition of the meshlet building and culling
+//
+
+#include <Meshlets.h>
+
+#include <algorithm> // min, max
+#include <cmath> // sqrtf
+
+//////////////////////
+//
+// Building
+//
+//////////////////////
+
+// computes the bounding sphere and normal cone of the triangles of the meshlet
+static void computeMeshletBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet) {
+    uint32_t lastIndex = meshlet.firstIndex + meshlet.indexCount;
+
+    // the sphere is centred on the box around the vertices, which is closer to the smallest sphere than the centroid
+    glm::vec3 minimum = vertices[indices[meshlet.firstIndex]].pos;
+    glm::vec3 maximum = minimum;
+    for (uint32_t i = meshlet.firstIndex; i < lastIndex; i++) {
+        minimum = glm::min(minimum, vertices[indices[i]].pos);
+        maximum = glm::max(maximum, vertices[indices[i]].pos);
+    }
+    meshlet.centre = (minimum + maximum) * 0.5f;
+
+    float radiusSquared = 0.0f;
+    for (uint32_t i = meshlet.firstIndex; i < lastIndex; i++) {
+        glm::vec3 offset = vertices[indices[i]].pos - meshlet.centre;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    meshlet.radius = sqrtf(radiusSquared);
+
+    // the cone axis is the average of the unit face normals, every face counts the same whatever its area
+    std::vector<glm::vec3> faceNormals;
+    faceNormals.reserve(meshlet.indexCount / 3);
+    glm::vec3 axis = glm::vec3(0.0f);
+    for (uint32_t i = meshlet.firstIndex; i < lastIndex; i += 3) {
+        const glm::vec3& a = vertices[indices[i + 0]].pos;
+        const glm::vec3& b = vertices[indices[i + 1]].pos;
+        const glm::vec3& c = vertices[indices[i + 2]].pos;
+        // counter clockwise triangles are front facing, so this points out of the front face
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            faceNormals.push_back(normal / length);
+            axis += faceNormals.back();
+        }
+    }
+
+    // leave the cone disabled if the normals cancel out
+    float axisLength = glm::length(axis);
+    if (faceNormals.empty() || axisLength < 1e-6f) {
+        return;
+    }
+    axis /= axisLength;
+
+    // the half angle of the cone is the largest angle between the axis and a face normal
+    float minimumDot = 1.0f;
+    for (const glm::vec3& normal : faceNormals) {
+        minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+    }
+
+    // a cone wider than a hemisphere can always be seen from the front
+    if (minimumDot <= 0.0f) {
+        return;
+    }
+
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+}
+
+void meshlets::buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount,
+    uint32_t materialIndex, std::vector<Meshlet>& meshlets) {
+    if (indexCount == 0) {
+        return;
+    }
+
+    // the meshlet that last referenced each vertex, to count the unique vertices of the current meshlet
+    std::vector<uint32_t> lastMeshlet(vertices.size(), UINT32_MAX);
+    uint32_t meshletId = 0;
+
+    Meshlet meshlet{};
+    meshlet.firstIndex = firstIndex;
+    meshlet.materialIndex = materialIndex;
+    for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3) {
+        uint32_t newVertices = 0;
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            // a vertex repeated within the triangle is only counted once
+            uint32_t v = indices[i + corner];
+            bool repeated = (corner > 0 && indices[i] == v) || (corner > 1 && indices[i + 1] == v);
+            if (lastMeshlet[v] != meshletId && !repeated) {
+                newVertices++;
+            }
+        }
+
+        // close the current meshlet if the triangle does not fit in it
+        if (meshlet.vertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.indexCount == 3 * MESHLET_MAX_TRIANGLES) {
+            computeMeshletBounds(vertices, indices, meshlet);
+            meshlets.push_back(meshlet);
+
+            meshlet = Meshlet{};
+            meshlet.firstIndex = i;
+            meshlet.materialIndex = materialIndex;
+            meshletId++;
+        }
+
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t v = indices[i + corner];
+            if (lastMeshlet[v] != meshletId) {
+                lastMeshlet[v] = meshletId;
+                meshlet.vertexCount++;
+            }
+        }
+        meshlet.indexCount += 3;
+    }
+
+    computeMeshletBounds(vertices, indices, meshlet);
+    meshlets.push_back(meshlet);
+}
+
+//////////////////////
+//
+// Culling
+//
+//////////////////////
+
+uint32_t meshlets::cullMeshlets(const std::vector<Meshlet>& meshlets, uint32_t firstMeshlet, uint32_t meshletCount, const glm::mat4& modelViewProj,
+    const glm::vec3& cameraPosition, std::vector<VkDrawIndexedIndirectCommand>& drawCommands) {
+    // extract the frustum planes from the rows of the matrix (Gribb & Hartmann), they are in model space because the
+    // matrix includes the model transform. The near plane z >= -w is looser than needed for a [0, 1] depth range
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(modelViewProj[0][row], modelViewProj[1][row], modelViewProj[2][row], modelViewProj[3][row]);
+    }
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0], // left, right
+        rows[3] + rows[1], rows[3] - rows[1], // top, bottom
+        rows[3] + rows[2], rows[3] - rows[2], // near, far
+    };
+    for (glm::vec4& plane : planes) {
+        // normalise so that the plane equation gives distances, which are compared to the radii
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+
+    drawCommands.clear();
+    uint32_t visibleMeshlets = 0;
+
+    for (uint32_t m = firstMeshlet; m < firstMeshlet + meshletCount; m++) {
+        const Meshlet& meshlet = meshlets[m];
+
+        // frustum test, the meshlet is culled if its sphere is entirely behind one of the planes
+        bool outside = false;
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), meshlet.centre) + plane.w < -meshlet.radius) {
+                outside = true;
+                break;
+            }
+        }
+        if (outside) {
+            continue;
+        }
+
+        // cone test, the meshlet is culled if every triangle faces away from the camera for any point of its sphere
+        glm::vec3 view = meshlet.centre - cameraPosition;
+        if (meshlet.coneCutoff < 1.0f && glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius) {
+            continue;
+        }
+
+        visibleMeshlets++;
+
+        // extend the previous draw if it ends where this meshlet starts and draws with the same material
+        if (!drawCommands.empty() && drawCommands.back().firstIndex + drawCommands.back().indexCount == meshlet.firstIndex
+            && drawCommands.back().firstInstance == meshlet.materialIndex) {
+            drawCommands.back().indexCount += meshlet.indexCount;
+            continue;
+        }
+
+        VkDrawIndexedIndirectCommand drawCommand{};
+        drawCommand.indexCount = meshlet.indexCount;
+        drawCommand.instanceCount = 1;
+        drawCommand.firstIndex = meshlet.firstIndex;
+        drawCommand.vertexOffset = 0;
+        // gl_InstanceIndex in the vertex shader, which passes it on to the fragment shader to index the material table
+        drawCommand.firstInstance = meshlet.materialIndex;
+        drawCommands.push_back(drawCommand);
+    }
+
+    return visibleMeshlets;
+}
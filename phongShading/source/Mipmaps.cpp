@@ -0,0 +1,140 @@
+//
+// Definition of the cpu mip chain generation
+//
+
+#include <Mipmaps.h>
+
+#include <Parallel.h> // parallelFor
+
+#include <algorithm> // min, max
+#include <cmath> // powf
+
+// SSE2 is always there on x64, and on x86 when the compiler targets it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPMAPS_USE_SSE
+#endif
+
+//////////////////////
+//
+// Channel conversion
+//
+//////////////////////
+
+// lookup tables between the 8 bit channels and linear floats, the transfer functions are far too slow per texel
+struct ChannelTables {
+    // the linear value of each 8 bit channel, decoded from sRGB or simply normalised
+    float   srgbToLinear[256];
+    float   unormToLinear[256];
+    // the 8 bit sRGB encoding of the linear value i / (MIPMAPS_LINEAR_STEPS - 1)
+    uint8_t linearToSrgb[MIPMAPS_LINEAR_STEPS];
+};
+
+static const ChannelTables& channelTables() {
+    static const ChannelTables tables = [] {
+        ChannelTables t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            t.srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            t.unormToLinear[i] = c;
+        }
+        for (uint32_t i = 0; i < MIPMAPS_LINEAR_STEPS; i++) {
+            float c = i / (float)(MIPMAPS_LINEAR_STEPS - 1);
+            float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+            t.linearToSrgb[i] = static_cast<uint8_t>(std::min(srgb * 255.0f + 0.5f, 255.0f));
+        }
+        return t;
+    }();
+    return tables;
+}
+
+// writes the average of four texels to output
+static inline void averageTexels(const uint8_t* a, const uint8_t* b, const uint8_t* c, const uint8_t* d, uint8_t* output,
+    const float* colourToLinear, const float* alphaToLinear, const uint8_t* linearToColour) {
+#ifdef MIPMAPS_USE_SSE
+    // the decoding is a table lookup per channel, the sum and scaling back to integers are done on the four channels at once
+    auto decode = [&](const uint8_t* texel) {
+        return _mm_setr_ps(colourToLinear[texel[0]], colourToLinear[texel[1]], colourToLinear[texel[2]], alphaToLinear[texel[3]]);
+    };
+    __m128 sum = _mm_add_ps(_mm_add_ps(decode(a), decode(b)), _mm_add_ps(decode(c), decode(d)));
+
+    // to the index of the encoding table for the colour, or straight to 8 bits, and to 8 bits for the alpha
+    float colourScale = linearToColour ? (float)(MIPMAPS_LINEAR_STEPS - 1) : 255.0f;
+    __m128 scale = _mm_setr_ps(colourScale * 0.25f, colourScale * 0.25f, colourScale * 0.25f, 255.0f * 0.25f);
+    __m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(sum, scale), _mm_set1_ps(0.5f)));
+
+    alignas(16) int32_t channels[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(channels), rounded);
+#else
+    float colourScale = linearToColour ? (float)(MIPMAPS_LINEAR_STEPS - 1) : 255.0f;
+    int32_t channels[4];
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        const float* toLinear = channel < 3 ? colourToLinear : alphaToLinear;
+        float sum = toLinear[a[channel]] + toLinear[b[channel]] + toLinear[c[channel]] + toLinear[d[channel]];
+        channels[channel] = static_cast<int32_t>(sum * 0.25f * (channel < 3 ? colourScale : 255.0f) + 0.5f);
+    }
+#endif
+
+    for (uint32_t channel = 0; channel < 3; channel++) {
+        output[channel] = linearToColour ? linearToColour[channels[channel]] : static_cast<uint8_t>(channels[channel]);
+    }
+    output[3] = static_cast<uint8_t>(channels[3]);
+}
+
+//////////////////////
+//
+// Mip chain
+//
+//////////////////////
+
+uint32_t mipmaps::levelCount(uint32_t width, uint32_t height) {
+    // halve the largest side until it reaches 1
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        levels++;
+    }
+    return levels;
+}
+
+size_t mipmaps::chainSize(uint32_t width, uint32_t height, uint32_t levels) {
+    size_t size = 0;
+    for (uint32_t level = 0; level < levels; level++) {
+        size += (size_t)width * height * 4;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return size;
+}
+
+void mipmaps::generateChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levels, bool srgb) {
+    const ChannelTables& tables = channelTables();
+    const float* colourToLinear = srgb ? tables.srgbToLinear : tables.unormToLinear;
+    const uint8_t* linearToColour = srgb ? tables.linearToSrgb : nullptr;
+
+    const uint8_t* source = chain;
+    uint32_t sourceWidth = width, sourceHeight = height;
+    for (uint32_t level = 1; level < levels; level++) {
+        // each level is made from the one before, which is complete once the workers are done
+        uint8_t* destination = chain + chainSize(width, height, level);
+        uint32_t levelWidth = std::max(sourceWidth / 2, 1u);
+        uint32_t levelHeight = std::max(sourceHeight / 2, 1u);
+
+        parallel::parallelFor(levelHeight, [&](size_t begin, size_t end, uint32_t) {
+            for (size_t y = begin; y < end; y++) {
+                const uint8_t* row0 = source + std::min<size_t>(2 * y + 0, sourceHeight - 1) * sourceWidth * 4;
+                const uint8_t* row1 = source + std::min<size_t>(2 * y + 1, sourceHeight - 1) * sourceWidth * 4;
+                uint8_t* output = destination + y * levelWidth * 4;
+                for (uint32_t x = 0; x < levelWidth; x++) {
+                    uint32_t x0 = std::min(2 * x + 0, sourceWidth - 1);
+                    uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+                    averageTexels(row0 + 4 * x0, row0 + 4 * x1, row1 + 4 * x0, row1 + 4 * x1, output + 4 * x,
+                        colourToLinear, tables.unormToLinear, linearToColour);
+                }
+            }
+        });
+
+        source = destination;
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+}
@@ -4,67 +4,360 @@
 
 #include <string> // string class
 #include <Model.h> // model class declaration
+#include <MeshUtils.h> // mesh processing passes
+#include <MeshCache.h> // binary mesh cache
+#include <Parallel.h> // parallelFor
+#include <Simplifier.h> // quadric mesh simplification
+#include <Bounds.h> // bounding volumes
+
+#include <algorithm> // find, max
+#include <filesystem> // directory of the mtl files
 
 // model loading
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include <ObjParser.h> // multi-threaded obj parser
 
 void Model::loadModel(const std::string& path) {
-    // setup variables to get model info
-    tinyobj::attrib_t attrib; // contains all the positions, normals, textures and faces
-    std::vector<tinyobj::shape_t> shapes; // all the separate objects and their faces
-    std::vector<tinyobj::material_t> materials; // object materials
-    std::string warn, err;
+    // the mesh never changes between runs, so a valid cache holds exactly what the steps below would produce
+    if (!enableMeshCache || !MeshCache::readCache(path, *this)) {
+        loadObj(path);
+        optimiseMesh();
+        buildLods();
+        computeBounds();
 
-    // load the model, show error if not
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
-        throw std::runtime_error(warn + err);
+        if (enableMeshCache) {
+            // failing to write the cache is not an error, the obj will simply be parsed again next time
+            MeshCache::writeCache(path, *this);
+        }
     }
 
-    // combine all the shapes into a single model
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex{};
+    // the meshlets follow the final triangle order, a single pass over the indices of each submesh
+    meshlets.clear();
+    for (auto& lod : lods) {
+        lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+        for (uint32_t s = lod.firstSubmesh; enableMeshlets && s < lod.firstSubmesh + lod.submeshCount; s++) {
+            const Submesh& submesh = submeshes[s];
+            meshlets::buildMeshlets(vertices, indices, submesh.firstIndex, submesh.indexCount, submesh.materialIndex, meshlets);
+        }
+        lod.meshletCount = static_cast<uint32_t>(meshlets.size()) - lod.firstMeshlet;
+    }
+}
 
-            // set vertex data
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
+// builds the vertex of each obj face corner and welds it into the model's vertices. The corners without a normal, or
+// all of them if recomputeNormals is set, take the generated normal of their position
+static void weldCorners(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::index_t>& corners, const std::vector<glm::vec3>& generatedNormals,
+    bool recomputeNormals, VertexWelder& welder, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    for (const auto& index : corners) {
+        Vertex vertex{};
 
+        // set vertex data
+        vertex.pos = {
+            attrib.vertices[3 * index.vertex_index + 0],
+            attrib.vertices[3 * index.vertex_index + 1],
+            attrib.vertices[3 * index.vertex_index + 2]
+        };
+
+        // a missing attribute has an index of -1
+        if (recomputeNormals || index.normal_index < 0) {
+            vertex.normal = generatedNormals[index.vertex_index];
+        }
+        else {
             vertex.normal = {
                 attrib.normals[3 * index.normal_index + 0],
                 attrib.normals[3 * index.normal_index + 1],
                 attrib.normals[3 * index.normal_index + 2]
             };
+        }
 
-            vertex.material = glm::vec4(0.1f, 0.5f, 0.7f, 38.0f);
-
+        if (index.texcoord_index >= 0) {
             vertex.texCoord = {
                 attrib.texcoords[2 * index.texcoord_index + 0],
                 1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
             };
+        }
+
+        indices.push_back(welder.insertVertex(vertex, vertices));
+    }
+}
+
+// the obj material in the layout of the material table
+static Material convertMaterial(const tinyobj::material_t& objMaterial) {
+    Material material{};
+    material.ambient = glm::vec4(objMaterial.ambient[0], objMaterial.ambient[1], objMaterial.ambient[2], 1.0f);
+    material.diffuse = glm::vec4(objMaterial.diffuse[0], objMaterial.diffuse[1], objMaterial.diffuse[2], 1.0f);
+    material.specular = glm::vec4(objMaterial.specular[0], objMaterial.specular[1], objMaterial.specular[2], objMaterial.shininess);
+    return material;
+}
+
+// renumbers the vertices used by a range of the indices from 0 in order of first use, so that the passes run on a
+// single submesh only do work (and allocate memory) for its own vertices. localOf maps the model's vertices to the
+// local ones, it must be all UINT32_MAX and is left that way, globalOf maps them back
+static void localiseIndices(const uint32_t* indices, size_t indexCount, std::vector<uint32_t>& localOf, std::vector<uint32_t>& globalOf,
+    std::vector<uint32_t>& localIndices) {
+    globalOf.clear();
+    localIndices.resize(indexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t v = indices[i];
+        if (localOf[v] == UINT32_MAX) {
+            localOf[v] = static_cast<uint32_t>(globalOf.size());
+            globalOf.push_back(v);
+        }
+        localIndices[i] = localOf[v];
+    }
+
+    for (uint32_t v : globalOf) {
+        localOf[v] = UINT32_MAX;
+    }
+}
+
+void Model::loadObj(const std::string& path) {
+    // setup variables to get model info
+    tinyobj::attrib_t attrib; // contains all the positions, normals, textures and faces
+    std::vector<tinyobj::shape_t> shapes; // all the separate objects and their faces
+    std::vector<tinyobj::material_t> objMaterials; // object materials
+    std::string warn, err;
+
+    if (useParallelObjParser) {
+        // parse on all cores, all the shapes end up in a single one
+        shapes.resize(1);
+        objparser::loadObjParallel(path, attrib, shapes[0].mesh.indices, shapes[0].mesh.material_ids, objMaterials);
+    }
+    else {
+        // the mtl files are next to the obj file, older versions of tinyobj expect the directory to end with a separator
+        std::string materialDirectory = std::filesystem::path(path).parent_path().string();
+        materialDirectory += materialDirectory.empty() ? "" : "/";
+
+        // load the model, show error if not
+        if (!tinyobj::LoadObj(&attrib, &shapes, &objMaterials, &warn, &err, path.c_str(), materialDirectory.c_str())) {
+            throw std::runtime_error(warn + err);
+        }
+    }
+
+    // count the face corners in advance so that the welding table never needs to grow
+    size_t faceCorners = 0;
+    for (const auto& shape : shapes) {
+        faceCorners += shape.mesh.indices.size();
+    }
+
+    // an obj face corner indexes positions, normals and texture coordinates separately, vertices that share all three
+    // are welded together so that each unique vertex is only uploaded (and shaded) once
+    VertexWelder welder;
+    welder.initWelder(faceCorners);
+    indices.reserve(faceCorners);
+
+    // smooth normals are generated from the positions if the obj lacks some, or if asked to replace its own. They are
+    // made before welding, per obj position rather than per vertex, so that they stay smooth across uv seams
+    bool missingNormals = false;
+    for (const auto& shape : shapes) {
+        for (const auto& index : shape.mesh.indices) {
+            missingNormals = missingNormals || index.normal_index < 0;
+        }
+    }
+    std::vector<glm::vec3> generatedNormals;
+    if (recomputeNormals || missingNormals) {
+        std::vector<uint32_t> positionIndices;
+        positionIndices.reserve(faceCorners);
+        for (const auto& shape : shapes) {
+            for (const auto& index : shape.mesh.indices) {
+                positionIndices.push_back(static_cast<uint32_t>(index.vertex_index));
+            }
+        }
+        generatedNormals = meshutils::generateNormals(attrib.vertices, positionIndices);
+    }
 
-            // add to the centre of gravity
-            centreOfGravity += vertex.pos;
+    // combine all the shapes into a single model
+    for (const auto& shape : shapes) {
+        weldCorners(attrib, shape.mesh.indices, generatedNormals, recomputeNormals, welder, vertices, indices);
+    }
+
+    // the material table, faces without a material (or with one missing from the mtl files) use a default one at the end
+    materials.clear();
+    for (const auto& objMaterial : objMaterials) {
+        materials.push_back(convertMaterial(objMaterial));
+    }
+    uint32_t defaultMaterial = static_cast<uint32_t>(materials.size());
+
+    // the material of each triangle, in the same order as the welded indices
+    std::vector<uint32_t> triangleMaterials;
+    triangleMaterials.reserve(indices.size() / 3);
+    for (const auto& shape : shapes) {
+        for (size_t t = 0; t < shape.mesh.indices.size() / 3; t++) {
+            int materialId = t < shape.mesh.material_ids.size() ? shape.mesh.material_ids[t] : -1;
+            bool known = materialId >= 0 && materialId < static_cast<int>(defaultMaterial);
+            triangleMaterials.push_back(known ? static_cast<uint32_t>(materialId) : defaultMaterial);
+        }
+    }
+    // the table is never empty, a storage buffer can't be
+    if (materials.empty() || std::find(triangleMaterials.begin(), triangleMaterials.end(), defaultMaterial) != triangleMaterials.end()) {
+        materials.push_back(Material{});
+    }
+
+    // group the triangles by material with a counting sort, which keeps their order within each material. The vertices
+    // stay shared, so a vertex on the border between two materials is still only stored once
+    std::vector<uint32_t> materialStart(materials.size() + 1, 0);
+    for (uint32_t material : triangleMaterials) {
+        materialStart[material + 1]++;
+    }
+    for (size_t m = 0; m < materials.size(); m++) {
+        materialStart[m + 1] += materialStart[m];
+    }
+
+    std::vector<uint32_t> groupedIndices(indices.size());
+    std::vector<uint32_t> nextTriangle(materialStart.begin(), materialStart.end() - 1);
+    for (size_t t = 0; t < triangleMaterials.size(); t++) {
+        uint32_t triangle = nextTriangle[triangleMaterials[t]]++;
+        std::copy(indices.begin() + 3 * t, indices.begin() + 3 * t + 3, groupedIndices.begin() + 3 * triangle);
+    }
+    indices.swap(groupedIndices);
+
+    // one submesh per material that is used, in material order
+    submeshes.clear();
+    for (uint32_t m = 0; m < materials.size(); m++) {
+        if (materialStart[m + 1] > materialStart[m]) {
+            submeshes.push_back({ 3 * materialStart[m], 3 * (materialStart[m + 1] - materialStart[m]), m });
+        }
+    }
+
+    // record how much the welding saved
+    stats.faceCorners = faceCorners;
+    stats.uniqueVertices = vertices.size();
+    stats.dedupeRatio = vertices.empty() ? 1.0f : (float)faceCorners / (float)vertices.size();
+}
+
+void Model::optimiseMesh() {
+    // reorder the triangles for the post-transform vertex cache, so that fewer vertices are shaded more than once
+    stats.acmrBefore = meshutils::computeACMR(indices, vertices.size(), VERTEX_CACHE_SIZE);
+    // each submesh on its own so that the triangles stay grouped by material
+    std::vector<uint32_t> localOf(vertices.size(), UINT32_MAX), globalOf, localIndices;
+    for (const auto& submesh : submeshes) {
+        localiseIndices(indices.data() + submesh.firstIndex, submesh.indexCount, localOf, globalOf, localIndices);
+        meshutils::optimiseVertexCache(localIndices, globalOf.size(), VERTEX_CACHE_SIZE);
+        for (uint32_t i = 0; i < submesh.indexCount; i++) {
+            indices[submesh.firstIndex + i] = globalOf[localIndices[i]];
+        }
+    }
+    stats.acmrAfter = meshutils::computeACMR(indices, vertices.size(), VERTEX_CACHE_SIZE);
+
+    // the vertices are still in obj order, so neighbouring triangles fetch vertices from all over the buffer. Laying 
+    // them out in the order the reordered indices reference them makes the fetches mostly sequential
+    stats.fetchMissesBefore = meshutils::computeFetchMisses(indices, vertices.size(), sizeof(Vertex), FETCH_CACHE_LINE_SIZE, FETCH_CACHE_LINES);
+    if (enableVertexFetchOptimisation) {
+        meshutils::optimiseVertexFetch(vertices, indices);
+    }
+    stats.fetchMissesAfter = meshutils::computeFetchMisses(indices, vertices.size(), sizeof(Vertex), FETCH_CACHE_LINE_SIZE, FETCH_CACHE_LINES);
+}
+
+void Model::buildLods() {
+    // the full resolution mesh is the first level
+    lods.clear();
+    ModelLod lod{};
+    lod.indexCount = static_cast<uint32_t>(indices.size());
+    lod.submeshCount = static_cast<uint32_t>(submeshes.size());
+    lods.push_back(lod);
 
-            vertices.push_back(vertex);
-            indices.push_back(indices.size());
+    // simplify each level from the previous one, it is smaller and already simplified most of the way
+    std::vector<uint32_t> localOf(vertices.size(), UINT32_MAX), globalOf, localIndices, simplified;
+    std::vector<Vertex> localVertices;
+    while (enableLods && lods.size() < MODEL_MAX_LODS) {
+        ModelLod previous = lods.back();
+        if ((previous.indexCount / 6) * 3 < 3 * MODEL_MIN_LOD_TRIANGLES) {
+            break;
         }
+
+        lod.firstIndex = static_cast<uint32_t>(indices.size());
+        lod.firstSubmesh = static_cast<uint32_t>(submeshes.size());
+        float error = 0.0f;
+
+        // each submesh is halved on its own, the borders between materials are open borders to the simplifier so it
+        // keeps them in place
+        for (uint32_t s = previous.firstSubmesh; s < previous.firstSubmesh + previous.submeshCount; s++) {
+            Submesh submesh = submeshes[s];
+            localiseIndices(indices.data() + submesh.firstIndex, submesh.indexCount, localOf, globalOf, localIndices);
+            localVertices.resize(globalOf.size());
+            for (size_t v = 0; v < globalOf.size(); v++) {
+                localVertices[v] = vertices[globalOf[v]];
+            }
+
+            error = std::max(error, simplifier::simplifyMesh(localVertices, localIndices, (submesh.indexCount / 6) * 3, simplified));
+
+            // the simplified triangles are in the order of the previous level, reorder them for the vertex cache too
+            meshutils::optimiseVertexCache(simplified, localVertices.size(), VERTEX_CACHE_SIZE);
+
+            // a small submesh can disappear altogether
+            submesh.firstIndex = static_cast<uint32_t>(indices.size());
+            submesh.indexCount = static_cast<uint32_t>(simplified.size());
+            if (submesh.indexCount > 0) {
+                submeshes.push_back(submesh);
+            }
+            for (uint32_t index : simplified) {
+                indices.push_back(globalOf[index]);
+            }
+        }
+
+        lod.indexCount = static_cast<uint32_t>(indices.size()) - lod.firstIndex;
+        lod.submeshCount = static_cast<uint32_t>(submeshes.size()) - lod.firstSubmesh;
+
+        // not worth a level if the simplifier got stuck well short of the target
+        if (lod.indexCount > previous.indexCount - previous.indexCount / 4) {
+            indices.resize(lod.firstIndex);
+            submeshes.resize(lod.firstSubmesh);
+            break;
+        }
+
+        // the errors of the successive simplifications add up
+        lod.error = previous.error + error;
+        lods.push_back(lod);
     }
+}
 
-    // now compute the centre by dividing by the number of vertices in the model
-    centreOfGravity /= (float)vertices.size();
+uint32_t Model::selectLod(float projectedSpan, float maxErrorPixels) const {
+    if (lods.empty() || modelSpan <= 0.0f) {
+        return 0;
+    }
 
-    modelSpan = 0;
-    // using the centre of gravity, determine the point that is furthest away
-    for (const auto& vertex : vertices) {
-        float distance = glm::distance(vertex.pos, centreOfGravity);
-        if (distance > modelSpan)
-            modelSpan = distance;
+    // the errors are in model space, so scale them by the size of a model space unit on screen
+    float pixelsPerUnit = projectedSpan / modelSpan;
+    uint32_t lod = static_cast<uint32_t>(lods.size()) - 1;
+    while (lod > 0 && lods[lod].error * pixelsPerUnit > maxErrorPixels) {
+        lod--;
     }
-    // just use the result doubled as the model span
-    modelSpan *= 2;
+    return lod;
+}
+
+void Model::computeBounds() {
+    // a single vectorised pass for the box and centroid, and another one for the sphere
+    bounds = bounds::computeBounds(vertices);
+
+    centreOfGravity = bounds.centroid;
+    modelSpan = 2.0f * bounds.sphereRadius;
+}
+
+
+size_t Model::positionStreamSize() const {
+    return sizeof(VertexPosition) * vertices.size();
+}
+
+size_t Model::attributeStreamSize() const {
+    return (packVertexAttributes ? sizeof(PackedVertexAttributes) : sizeof(VertexAttributes)) * vertices.size();
 }
 
+void Model::writeVertexStreams(void* positionStream, void* attributeStream) const {
+    // cheap to derive from the vertices, so not worth caching. Each vertex is written once and never read back, which
+    // suits uncached staging memory
+    VertexPosition* positions = static_cast<VertexPosition*>(positionStream);
+    PackedVertexAttributes* packedAttributes = static_cast<PackedVertexAttributes*>(attributeStream);
+    VertexAttributes* attributes = static_cast<VertexAttributes*>(attributeStream);
+
+    parallel::parallelFor(vertices.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t v = begin; v < end; v++) {
+            positions[v] = VertexPosition::fromVertex(vertices[v]);
+            if (packVertexAttributes) {
+                packedAttributes[v] = PackedVertexAttributes::pack(vertices[v]);
+            }
+            else {
+                attributes[v] = VertexAttributes::fromVertex(vertices[v]);
+            }
+        }
+    });
+}
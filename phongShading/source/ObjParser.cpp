@@ -0,0 +1,528 @@
+//
+// Definition of the multi-threaded obj parser
+//
+
+#include <ObjParser.h>
+
+#include <Parallel.h> // parallelFor
+#include <MeshUtils.h> // normal generation benchmark
+
+#include <cstring> // memchr, memcpy
+#include <cmath> // pow
+#include <cstdio> // snprintf
+#include <fstream> // file i/o
+#include <iostream> // benchmark output
+#include <chrono> // benchmark timing
+#include <stdexcept> // reporting errors
+#include <algorithm> // min, max
+#include <sstream> // splitting mtllib records
+#include <filesystem> // directory of the obj file
+
+//////////////////////
+//
+// Chunk parsing
+//
+//////////////////////
+
+// the geometry parsed from one line aligned chunk of the file
+struct ObjChunk {
+    // the part of the file to parse
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    // attributes in the order they appear in the chunk
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texCoords;
+
+    // triangulated face corners. Positive obj indices are absolute so they are final, negative ones are relative to the
+    // attributes read so far, which is only known within the chunk
+    std::vector<tinyobj::index_t> corners;
+    // the corner attributes that are relative to the start of the chunk, as corner * 3 + attribute (0 = position, 1 = normal, 2 = texture coordinate)
+    std::vector<size_t> relativeCorners;
+
+    // the material records. The materials are only known once the libraries before them are read, so the names are
+    // resolved in file order after parsing. Each change applies from the given triangle of the chunk onwards
+    std::vector<std::string> materialLibraries;
+    std::vector<std::pair<size_t, std::string>> materialChanges;
+    std::vector<int> materialChangeIds;
+};
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// the rest of the line without the spaces around it, names may contain spaces
+static std::string parseName(const char* p, const char* end) {
+    p = skipSpaces(p, end);
+    while (end > p && isSpace(end[-1])) {
+        end--;
+    }
+    return std::string(p, end);
+}
+
+static const char* parseFloat(const char* p, const char* end, float& value) {
+    // much faster than strtof, which is also locale dependent. Accumulate the decimal digits in an integer and apply the
+    // exponent once at the end, which is accurate enough for single precision
+    p = skipSpaces(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    const char* digitsStart = p;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    // past 18 digits the mantissa would overflow, and the extra digits are beyond float precision anyway
+    for (; p < end && isDigit(*p); p++) {
+        if (mantissa < 100000000000000000ull) {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+        else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (p == digitsStart) {
+        throw std::runtime_error("failed to parse obj number!");
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int explicitExponent = 0;
+        for (; p < end && isDigit(*p); p++) {
+            explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 1000);
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    // powers of ten up to 22 are exact in double precision, so dividing or multiplying by them rounds correctly
+    static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        result = exponent >= -22 ? result / powersOfTen[-exponent] : result * std::pow(10.0, exponent);
+    }
+    else if (exponent > 0) {
+        result = exponent <= 22 ? result * powersOfTen[exponent] : result * std::pow(10.0, exponent);
+    }
+
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+static const char* parseIndex(const char* p, const char* end, int& value) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+
+    const char* digitsStart = p;
+    int64_t result = 0;
+    for (; p < end && isDigit(*p); p++) {
+        result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+    }
+    // obj indices start at 1, so 0 is not valid either
+    if (p == digitsStart || result == 0) {
+        throw std::runtime_error("failed to parse obj face index!");
+    }
+
+    value = static_cast<int>(negative ? -result : result);
+    return p;
+}
+
+// parses one face corner (v, v/vt, v//vn or v/vt/vn) and converts its indices to zero based, returns a mask of the
+// attributes that are relative to the start of the chunk
+static const char* parseCorner(const char* p, const char* end, const size_t attributeCounts[3], tinyobj::index_t& corner, uint32_t& relativeMask) {
+    // the obj order of the attributes is position / texture coordinate / normal
+    int raw[3] = { 0, 0, 0 };
+    p = parseIndex(p, end, raw[0]);
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            p = parseIndex(p, end, raw[2]);
+        }
+        if (p < end && *p == '/') {
+            p = parseIndex(p + 1, end, raw[1]);
+        }
+    }
+
+    // resolve each attribute, in our order of position, normal, texture coordinate
+    int resolved[3];
+    relativeMask = 0;
+    for (uint32_t attribute = 0; attribute < 3; attribute++) {
+        if (raw[attribute] > 0) {
+            resolved[attribute] = raw[attribute] - 1;
+        }
+        else if (raw[attribute] < 0) {
+            resolved[attribute] = static_cast<int>(attributeCounts[attribute]) + raw[attribute];
+            relativeMask |= 1 << attribute;
+        }
+        else {
+            resolved[attribute] = -1;
+        }
+    }
+
+    corner.vertex_index = resolved[0];
+    corner.normal_index = resolved[1];
+    corner.texcoord_index = resolved[2];
+    return p;
+}
+
+static void parseChunk(ObjChunk& chunk) {
+    // reused for every face
+    std::vector<tinyobj::index_t> polygon;
+    std::vector<uint32_t> polygonRelativeMasks;
+
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+        if (lineEnd == nullptr) {
+            lineEnd = chunk.end;
+        }
+
+        const char* q = skipSpaces(p, lineEnd);
+        size_t length = lineEnd - q;
+
+        if (length >= 2 && q[0] == 'v' && isSpace(q[1])) {
+            // position, ignoring the optional w and vertex colours
+            float x, y, z;
+            q = parseFloat(q + 1, lineEnd, x);
+            q = parseFloat(q, lineEnd, y);
+            q = parseFloat(q, lineEnd, z);
+            chunk.positions.insert(chunk.positions.end(), { x, y, z });
+        }
+        else if (length >= 3 && q[0] == 'v' && q[1] == 'n' && isSpace(q[2])) {
+            float x, y, z;
+            q = parseFloat(q + 2, lineEnd, x);
+            q = parseFloat(q, lineEnd, y);
+            q = parseFloat(q, lineEnd, z);
+            chunk.normals.insert(chunk.normals.end(), { x, y, z });
+        }
+        else if (length >= 3 && q[0] == 'v' && q[1] == 't' && isSpace(q[2])) {
+            // texture coordinate, ignoring the optional w like tinyobj does
+            float u, v;
+            q = parseFloat(q + 2, lineEnd, u);
+            q = parseFloat(q, lineEnd, v);
+            chunk.texCoords.insert(chunk.texCoords.end(), { u, v });
+        }
+        else if (length >= 2 && q[0] == 'f' && isSpace(q[1])) {
+            size_t attributeCounts[3] = { chunk.positions.size() / 3, chunk.normals.size() / 3, chunk.texCoords.size() / 2 };
+
+            polygon.clear();
+            polygonRelativeMasks.clear();
+            for (q = skipSpaces(q + 1, lineEnd); q < lineEnd && *q != '#'; q = skipSpaces(q, lineEnd)) {
+                tinyobj::index_t corner;
+                uint32_t relativeMask;
+                q = parseCorner(q, lineEnd, attributeCounts, corner, relativeMask);
+                polygon.push_back(corner);
+                polygonRelativeMasks.push_back(relativeMask);
+            }
+
+            // triangulate the polygon as a fan around its first corner
+            for (size_t k = 1; k + 1 < polygon.size(); k++) {
+                for (size_t polygonCorner : { (size_t)0, k, k + 1 }) {
+                    for (uint32_t attribute = 0; attribute < 3; attribute++) {
+                        if (polygonRelativeMasks[polygonCorner] & (1 << attribute)) {
+                            chunk.relativeCorners.push_back(chunk.corners.size() * 3 + attribute);
+                        }
+                    }
+                    chunk.corners.push_back(polygon[polygonCorner]);
+                }
+            }
+        }
+        else if (length >= 7 && memcmp(q, "usemtl", 6) == 0 && isSpace(q[6])) {
+            chunk.materialChanges.emplace_back(chunk.corners.size() / 3, parseName(q + 6, lineEnd));
+        }
+        else if (length >= 7 && memcmp(q, "mtllib", 6) == 0 && isSpace(q[6])) {
+            chunk.materialLibraries.push_back(parseName(q + 6, lineEnd));
+        }
+        // every other record (comments, groups, smoothing groups...) is skipped
+
+        p = lineEnd + 1;
+    }
+}
+
+//////////////////////
+//
+// Parsing
+//
+//////////////////////
+
+void objparser::loadMaterialLibrary(const std::string& directory, const std::string& names, std::map<std::string, int>& materialMap,
+    std::vector<tinyobj::material_t>& materials) {
+    std::istringstream nameStream(names);
+    std::string name;
+    while (nameStream >> name) {
+        std::ifstream file((std::filesystem::path(directory) / name).string());
+        if (file.is_open()) {
+            // the warnings are about unsupported or malformed mtl statements, which are skipped
+            std::string warn, err;
+            tinyobj::LoadMtl(&materialMap, &materials, &file, &warn, &err);
+            return;
+        }
+    }
+}
+
+void objparser::loadObjParallel(const std::string& path, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices,
+    std::vector<int>& materialIds, std::vector<tinyobj::material_t>& materials) {
+    // read the whole file in one go
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open obj file " + path + "!");
+    }
+    size_t fileSize = (size_t)file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+
+    //
+    // split the file into chunks that start and end on line boundaries
+    //
+
+    size_t chunkCount = std::max<size_t>(std::min<size_t>(parallel::workerCount(), fileSize / OBJ_MIN_CHUNK_SIZE), 1);
+    std::vector<ObjChunk> chunks(chunkCount);
+
+    const char* fileBegin = buffer.data();
+    const char* fileEnd = fileBegin + fileSize;
+    const char* chunkBegin = fileBegin;
+    for (size_t c = 0; c < chunkCount; c++) {
+        const char* chunkEnd = fileEnd;
+        if (c + 1 < chunkCount) {
+            // move the nominal split point forward to just after the end of its line
+            chunkEnd = std::max(chunkBegin, fileBegin + fileSize * (c + 1) / chunkCount);
+            const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', fileEnd - chunkEnd));
+            chunkEnd = newline ? newline + 1 : fileEnd;
+        }
+        chunks[c].begin = chunkBegin;
+        chunks[c].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    // parse the chunks concurrently
+    parallel::parallelFor(chunkCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t c = begin; c < end; c++) {
+            parseChunk(chunks[c]);
+        }
+    });
+
+    //
+    // resolve the material names in file order
+    //
+
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    std::map<std::string, int> materialMap;
+    // the material in use at the start of each chunk is the last one set before it
+    std::vector<int> chunkMaterial(chunkCount, -1);
+    int currentMaterial = -1;
+    for (size_t c = 0; c < chunkCount; c++) {
+        for (const auto& library : chunks[c].materialLibraries) {
+            loadMaterialLibrary(directory, library, materialMap, materials);
+        }
+        chunkMaterial[c] = currentMaterial;
+        for (const auto& change : chunks[c].materialChanges) {
+            // an unknown name falls back to no material, like tinyobj
+            auto material = materialMap.find(change.second);
+            currentMaterial = material != materialMap.end() ? material->second : -1;
+            chunks[c].materialChangeIds.push_back(currentMaterial);
+        }
+    }
+
+    //
+    // merge the chunks in file order
+    //
+
+    // where each chunk's data goes in the merged arrays
+    std::vector<size_t> positionBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0), texCoordBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+    for (size_t c = 0; c < chunkCount; c++) {
+        positionBase[c + 1] = positionBase[c] + chunks[c].positions.size() / 3;
+        normalBase[c + 1] = normalBase[c] + chunks[c].normals.size() / 3;
+        texCoordBase[c + 1] = texCoordBase[c] + chunks[c].texCoords.size() / 2;
+        cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size();
+    }
+
+    attrib.vertices.resize(positionBase[chunkCount] * 3);
+    attrib.normals.resize(normalBase[chunkCount] * 3);
+    attrib.texcoords.resize(texCoordBase[chunkCount] * 2);
+    size_t indexOffset = indices.size();
+    indices.resize(indexOffset + cornerBase[chunkCount]);
+    size_t triangleOffset = materialIds.size();
+    materialIds.resize(triangleOffset + cornerBase[chunkCount] / 3);
+
+    parallel::parallelFor(chunkCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t c = begin; c < end; c++) {
+            ObjChunk& chunk = chunks[c];
+
+            // relative indices become absolute once the number of attributes in the previous chunks is known
+            for (size_t relative : chunk.relativeCorners) {
+                tinyobj::index_t& corner = chunk.corners[relative / 3];
+                switch (relative % 3) {
+                case 0: corner.vertex_index += static_cast<int>(positionBase[c]); break;
+                case 1: corner.normal_index += static_cast<int>(normalBase[c]); break;
+                case 2: corner.texcoord_index += static_cast<int>(texCoordBase[c]); break;
+                }
+            }
+
+            // the model indexes the attribute arrays directly, so reject out of range indices here
+            for (const auto& corner : chunk.corners) {
+                if (corner.vertex_index < 0 || corner.vertex_index >= static_cast<int64_t>(positionBase[chunkCount])
+                    || corner.normal_index < -1 || corner.normal_index >= static_cast<int64_t>(normalBase[chunkCount])
+                    || corner.texcoord_index < -1 || corner.texcoord_index >= static_cast<int64_t>(texCoordBase[chunkCount])) {
+                    throw std::runtime_error("obj face index out of range!");
+                }
+            }
+
+            std::copy(chunk.positions.begin(), chunk.positions.end(), attrib.vertices.begin() + positionBase[c] * 3);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + normalBase[c] * 3);
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), attrib.texcoords.begin() + texCoordBase[c] * 2);
+            std::copy(chunk.corners.begin(), chunk.corners.end(), indices.begin() + indexOffset + cornerBase[c]);
+
+            // the material of each triangle, from the material in use at the start of the chunk and its changes
+            int* chunkMaterialIds = materialIds.data() + triangleOffset + cornerBase[c] / 3;
+            size_t triangle = 0;
+            int material = chunkMaterial[c];
+            for (size_t change = 0; change <= chunk.materialChanges.size(); change++) {
+                size_t changeTriangle = change < chunk.materialChanges.size() ? chunk.materialChanges[change].first : chunk.corners.size() / 3;
+                std::fill(chunkMaterialIds + triangle, chunkMaterialIds + changeTriangle, material);
+                triangle = changeTriangle;
+                if (change < chunk.materialChanges.size()) {
+                    material = chunk.materialChangeIds[change];
+                }
+            }
+
+            // release the chunk's memory as soon as it is merged
+            chunk = ObjChunk{};
+        }
+    });
+}
+
+//////////////////////
+//
+// Benchmark
+//
+//////////////////////
+
+void objparser::writeSyntheticObj(const std::string& path, size_t triangleCount) {
+    // a square grid of quads, each split into two triangles
+    size_t side = 1;
+    while (2 * side * side < triangleCount) {
+        side++;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to create synthetic obj file!");
+    }
+
+    // format into a large buffer rather than through the stream, which is very slow for millions of lines
+    std::string buffer;
+    buffer.reserve(1 << 22);
+    char line[128];
+    auto flush = [&](bool force) {
+        if (force || buffer.size() > (1 << 22) - sizeof(line)) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    };
+
+    for (size_t y = 0; y <= side; y++) {
+        for (size_t x = 0; x <= side; x++) {
+            float u = (float)x / side, v = (float)y / side;
+            // a gentle wave so that the normals are not all the same
+            float height = 0.1f * std::sin(u * 20.0f) * std::cos(v * 20.0f);
+            buffer.append(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u, height, v));
+            buffer.append(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v));
+            buffer.append(line, snprintf(line, sizeof(line), "vn 0.000000 1.000000 0.000000\n"));
+            flush(false);
+        }
+    }
+
+    for (size_t y = 0; y < side; y++) {
+        for (size_t x = 0; x < side; x++) {
+            // obj indices start at 1
+            size_t a = y * (side + 1) + x + 1, b = a + 1, c = a + side + 1, d = c + 1;
+            buffer.append(line, snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, b, b, b, d, d, d));
+            buffer.append(line, snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, d, d, d, c, c, c));
+            flush(false);
+        }
+    }
+    flush(true);
+}
+
+void objparser::runBenchmark(const std::vector<std::string>& paths) {
+    std::cout << "obj parsing benchmark, " << parallel::workerCount() << " workers" << std::endl;
+
+    for (const auto& path : paths) {
+        // tinyobj
+        auto start = std::chrono::high_resolution_clock::now();
+        tinyobj::attrib_t tinyAttrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        // older versions of tinyobj expect the mtl directory to end with a separator
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        directory += directory.empty() ? "" : "/";
+        if (!tinyobj::LoadObj(&tinyAttrib, &shapes, &materials, &warn, &err, path.c_str(), directory.c_str())) {
+            throw std::runtime_error(warn + err);
+        }
+        size_t tinyCorners = 0;
+        for (const auto& shape : shapes) {
+            tinyCorners += shape.mesh.indices.size();
+        }
+        float tinyTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+        // the parallel parser
+        start = std::chrono::high_resolution_clock::now();
+        tinyobj::attrib_t parallelAttrib;
+        std::vector<tinyobj::index_t> parallelIndices;
+        std::vector<int> parallelMaterialIds;
+        std::vector<tinyobj::material_t> parallelMaterials;
+        loadObjParallel(path, parallelAttrib, parallelIndices, parallelMaterialIds, parallelMaterials);
+        float parallelTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+        bool match = tinyCorners == parallelIndices.size() && tinyAttrib.vertices.size() == parallelAttrib.vertices.size()
+            && tinyAttrib.normals.size() == parallelAttrib.normals.size() && tinyAttrib.texcoords.size() == parallelAttrib.texcoords.size()
+            && materials.size() == parallelMaterials.size();
+
+        std::cout << path << ": " << tinyCorners / 3 << " triangles" << std::endl;
+        std::cout << "    tinyobj:  " << tinyTime << " ms" << std::endl;
+        std::cout << "    parallel: " << parallelTime << " ms (" << tinyTime / parallelTime << "x)" << (match ? "" : " /!\\ counts differ from tinyobj") << std::endl;
+
+        // the smooth normals the model generates for files without any
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<uint32_t> positionIndices(parallelIndices.size());
+        for (size_t i = 0; i < parallelIndices.size(); i++) {
+            positionIndices[i] = static_cast<uint32_t>(parallelIndices[i].vertex_index);
+        }
+        std::vector<glm::vec3> normals = meshutils::generateNormals(parallelAttrib.vertices, positionIndices);
+        float normalTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "    normals:  " << normalTime << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,54 @@
+//
+// Definition of the parallel functions
+//
+
+#include <Parallel.h>
+
+#include <thread> // worker threads
+#include <vector> // vector container
+#include <exception> // exception_ptr for propagating worker exceptions
+#include <algorithm> // min, max
+
+uint32_t parallel::workerCount() {
+    // may return 0 if the value is not computable
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void parallel::parallelFor(size_t count, const std::function<void(size_t begin, size_t end, uint32_t worker)>& task) {
+    uint32_t workers = static_cast<uint32_t>(std::min<size_t>(workerCount(), count));
+    if (workers <= 1) {
+        // not worth starting a thread, run on the calling thread
+        if (count > 0) {
+            task(0, count, 0);
+        }
+        return;
+    }
+
+    // the calling thread takes the first range, so only start workers - 1 threads
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> exceptions(workers);
+    auto runRange = [&](uint32_t worker) {
+        try {
+            task(count * worker / workers, count * (worker + 1) / workers, worker);
+        }
+        catch (...) {
+            exceptions[worker] = std::current_exception();
+        }
+    };
+
+    threads.reserve(workers - 1);
+    for (uint32_t worker = 1; worker < workers; worker++) {
+        threads.emplace_back(runRange, worker);
+    }
+    runRange(0);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto& exception : exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
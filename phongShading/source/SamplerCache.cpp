@@ -0,0 +1,111 @@
+//
+// Sampler cache definition
+//
+
+#include <SamplerCache.h>
+
+#include <cstring> // memcpy
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Cache key
+//
+//////////////////////
+
+size_t SamplerKeyHash::operator()(const SamplerKey& key) const {
+    // 64 bit FNV-1a hash of the words
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t word : key.words) {
+        hash ^= word;
+        hash *= 0x100000001b3ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+SamplerKey SamplerCache::makeKey(const VkSamplerCreateInfo& samplerInfo) {
+    // chained structs would change the sampler without being part of the key
+    if (samplerInfo.pNext != nullptr) {
+        throw std::runtime_error("failed to cache sampler, extended sampler create infos are not supported!");
+    }
+
+    // the floats are compared bit for bit, which is what matters for the sampler being the same
+    auto floatBits = [](float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(float));
+        return bits;
+    };
+
+    SamplerKey key{};
+    key.words = {
+        samplerInfo.flags,
+        static_cast<uint32_t>(samplerInfo.magFilter),
+        static_cast<uint32_t>(samplerInfo.minFilter),
+        static_cast<uint32_t>(samplerInfo.mipmapMode),
+        static_cast<uint32_t>(samplerInfo.addressModeU),
+        static_cast<uint32_t>(samplerInfo.addressModeV),
+        static_cast<uint32_t>(samplerInfo.addressModeW),
+        floatBits(samplerInfo.mipLodBias),
+        samplerInfo.anisotropyEnable,
+        floatBits(samplerInfo.maxAnisotropy),
+        samplerInfo.compareEnable,
+        static_cast<uint32_t>(samplerInfo.compareOp),
+        floatBits(samplerInfo.minLod),
+        floatBits(samplerInfo.maxLod),
+        static_cast<uint32_t>(samplerInfo.borderColor),
+        samplerInfo.unnormalizedCoordinates
+    };
+    return key;
+}
+
+//////////////////////
+//
+// Acquire and release samplers
+//
+//////////////////////
+
+void SamplerCache::createSamplerCache(VulkanSetup* pVkSetup) {
+    vkSetup = pVkSetup;
+}
+
+VkSampler SamplerCache::acquireSampler(const VkSamplerCreateInfo& samplerInfo) {
+    SamplerKey key = makeKey(samplerInfo);
+
+    // an existing sampler with the same configuration
+    auto cached = samplers.find(key);
+    if (cached != samplers.end()) {
+        cached->second.refCount++;
+        return cached->second.sampler;
+    }
+
+    VkSampler sampler;
+    if (vkCreateSampler(vkSetup->device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+    samplers[key] = { sampler, 1 };
+    samplerKeys[sampler] = key;
+    return sampler;
+}
+
+void SamplerCache::releaseSampler(VkSampler sampler) {
+    auto samplerKey = samplerKeys.find(sampler);
+    if (samplerKey == samplerKeys.end()) {
+        throw std::runtime_error("failed to release sampler, it was not acquired from the cache!");
+    }
+
+    auto cached = samplers.find(samplerKey->second);
+    if (--cached->second.refCount > 0) {
+        return;
+    }
+    vkDestroySampler(vkSetup->device, sampler, nullptr);
+    samplers.erase(cached);
+    samplerKeys.erase(samplerKey);
+}
+
+void SamplerCache::cleanupSamplerCache() {
+    for (auto& cached : samplers) {
+        vkDestroySampler(vkSetup->device, cached.second.sampler, nullptr);
+    }
+    samplers.clear();
+    samplerKeys.clear();
+}
@@ -0,0 +1,326 @@
+//
+// Definition of the mesh simplifier
+//
+
+#include <Simplifier.h>
+
+#include <algorithm> // sort, unique, min, max
+#include <cmath> // sqrt
+#include <cstring> // memcpy
+
+//////////////////////
+//
+// Quadrics
+//
+//////////////////////
+
+// a POD struct containing the weighted sum of the squared distances to a set of planes, as the symmetric 4x4 matrix
+// of the plane equations (upper triangle only) and the total weight
+struct Quadric {
+    double a2, ab, ac, ad;
+    double     b2, bc, bd;
+    double         c2, cd;
+    double             d2;
+    double weight;
+};
+
+// the quadric of the plane through point with the given unit normal
+static Quadric planeQuadric(const glm::vec3& normal, const glm::vec3& point, double weight) {
+    double a = normal.x, b = normal.y, c = normal.z;
+    double d = -(a * point.x + b * point.y + c * point.z);
+
+    Quadric q;
+    q.a2 = weight * a * a; q.ab = weight * a * b; q.ac = weight * a * c; q.ad = weight * a * d;
+    q.b2 = weight * b * b; q.bc = weight * b * c; q.bd = weight * b * d;
+    q.c2 = weight * c * c; q.cd = weight * c * d;
+    q.d2 = weight * d * d;
+    q.weight = weight;
+    return q;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other) {
+    q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+    q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+    q.c2 += other.c2; q.cd += other.cd;
+    q.d2 += other.d2;
+    q.weight += other.weight;
+}
+
+// the weighted mean of the squared distances from the point to the planes of the quadric
+static double evaluateQuadric(const Quadric& q, const glm::vec3& point) {
+    double x = point.x, y = point.y, z = point.z;
+    double error = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+                 + q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+                 + q.c2 * z * z + 2.0 * q.cd * z
+                 + q.d2;
+    // rounding can take it slightly below 0
+    return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+//////////////////////
+//
+// Simplification
+//
+//////////////////////
+
+// a POD struct containing a candidate edge collapse, moving the position from onto the position to
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double   error;
+};
+
+// follows the chain of collapses of an element to the one it ended up merged into
+static uint32_t resolve(std::vector<uint32_t>& remap, uint32_t element) {
+    uint32_t root = element;
+    while (remap[root] != root) {
+        root = remap[root];
+    }
+    // shorten the chain for the next lookups
+    while (remap[element] != root) {
+        uint32_t next = remap[element];
+        remap[element] = root;
+        element = next;
+    }
+    return root;
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+float simplifier::simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+    std::vector<uint32_t>& output) {
+    output = indices;
+    if (indices.size() <= targetIndexCount) {
+        return 0.0f;
+    }
+
+    //
+    // group the vertices by position, the collapses work on positions so that seams stay closed
+    //
+
+    std::vector<uint32_t> sortedVertices(vertices.size());
+    for (uint32_t v = 0; v < vertices.size(); v++) {
+        sortedVertices[v] = v;
+    }
+    auto positionLess = [&](uint32_t a, uint32_t b) {
+        return memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(glm::vec3)) < 0;
+    };
+    std::sort(sortedVertices.begin(), sortedVertices.end(), positionLess);
+
+    // the position of each vertex, and the vertices at each position in compressed form (offsets into a single array)
+    std::vector<uint32_t> positionOf(vertices.size());
+    std::vector<uint32_t> wedgeOffsets;
+    std::vector<glm::vec3> positions;
+    for (size_t i = 0; i < sortedVertices.size(); i++) {
+        if (i == 0 || positionLess(sortedVertices[i - 1], sortedVertices[i])) {
+            wedgeOffsets.push_back(static_cast<uint32_t>(i));
+            positions.push_back(vertices[sortedVertices[i]].pos);
+        }
+        positionOf[sortedVertices[i]] = static_cast<uint32_t>(positions.size() - 1);
+    }
+    wedgeOffsets.push_back(static_cast<uint32_t>(sortedVertices.size()));
+    const std::vector<uint32_t>& wedges = sortedVertices;
+    size_t positionCount = positions.size();
+
+    //
+    // quadrics of the planes of the triangles around each position, weighted by area
+    //
+
+    std::vector<Quadric> quadrics(positionCount, Quadric{});
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const glm::vec3& a = vertices[indices[i + 0]].pos;
+        const glm::vec3& b = vertices[indices[i + 1]].pos;
+        const glm::vec3& c = vertices[indices[i + 2]].pos;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        Quadric q = planeQuadric(normal / length, a, 0.5 * length);
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            addQuadric(quadrics[positionOf[indices[i + corner]]], q);
+        }
+    }
+
+    // edges used by a single triangle are on an open border, add a plane through them perpendicular to the triangle so
+    // that moving the border away from its line costs as much as moving the surface
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            edges.push_back(edgeKey(positionOf[indices[i + corner]], positionOf[indices[i + (corner + 1) % 3]]));
+        }
+    }
+    std::vector<uint64_t> sortedEdges = edges;
+    std::sort(sortedEdges.begin(), sortedEdges.end());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint64_t key = edges[i + corner];
+            auto range = std::equal_range(sortedEdges.begin(), sortedEdges.end(), key);
+            if (range.second - range.first != 1) {
+                continue;
+            }
+            uint32_t p0 = positionOf[indices[i + corner]];
+            uint32_t p1 = positionOf[indices[i + (corner + 1) % 3]];
+            uint32_t p2 = positionOf[indices[i + (corner + 2) % 3]];
+            glm::vec3 edge = positions[p1] - positions[p0];
+            glm::vec3 normal = glm::cross(edge, glm::cross(edge, positions[p2] - positions[p0]));
+            float length = glm::length(normal);
+            if (length == 0.0f) {
+                continue;
+            }
+            Quadric q = planeQuadric(normal / length, positions[p0], SIMPLIFIER_BORDER_WEIGHT * glm::dot(edge, edge));
+            addQuadric(quadrics[p0], q);
+            addQuadric(quadrics[p1], q);
+        }
+    }
+
+    //
+    // collapse edges in passes, each pass collapses the cheapest edges that do not touch each other
+    //
+
+    std::vector<uint32_t> vertexRemap(vertices.size());
+    for (uint32_t v = 0; v < vertices.size(); v++) {
+        vertexRemap[v] = v;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(positionCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<bool> locked(positionCount);
+    double maxError = 0.0;
+
+    while (output.size() > targetIndexCount) {
+        size_t triangleCount = output.size() / 3;
+
+        // the triangles around each position
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t v : output) {
+            adjacencyOffsets[positionOf[v] + 1]++;
+        }
+        for (size_t p = 0; p < positionCount; p++) {
+            adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+        }
+        adjacency.resize(output.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < output.size(); i++) {
+            adjacency[fill[positionOf[output[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // every edge once, with the cheaper of its two directions
+        edges.clear();
+        for (size_t i = 0; i < output.size(); i += 3) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                edges.push_back(edgeKey(positionOf[output[i + corner]], positionOf[output[i + (corner + 1) % 3]]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for (uint64_t key : edges) {
+            uint32_t a = static_cast<uint32_t>(key >> 32);
+            uint32_t b = static_cast<uint32_t>(key & 0xffffffff);
+            Quadric merged = quadrics[a];
+            addQuadric(merged, quadrics[b]);
+            double errorAtA = evaluateQuadric(merged, positions[a]);
+            double errorAtB = evaluateQuadric(merged, positions[b]);
+            collapses.push_back(errorAtA < errorAtB ? Collapse{ b, a, errorAtA } : Collapse{ a, b, errorAtB });
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+        // a collapse removes the triangles on its edge, two inside a mesh
+        size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+        size_t trianglesRemoved = 0;
+        size_t collapseCount = 0;
+        std::fill(locked.begin(), locked.end(), false);
+
+        for (const Collapse& collapse : collapses) {
+            if (trianglesRemoved >= trianglesToRemove) {
+                break;
+            }
+            // the triangles around both ends must not have changed since the adjacency was built
+            if (locked[collapse.from] || locked[collapse.to]) {
+                continue;
+            }
+
+            // moving from onto to must not flip any of the triangles that survive the collapse
+            bool flips = false;
+            size_t removed = 0;
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+                uint32_t triangle = adjacency[a];
+                glm::vec3 before[3], after[3];
+                bool onEdge = false;
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    uint32_t p = positionOf[output[3 * triangle + corner]];
+                    onEdge |= p == collapse.to;
+                    before[corner] = positions[p];
+                    after[corner] = p == collapse.from ? positions[collapse.to] : positions[p];
+                }
+                if (onEdge) {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            // lock the neighbourhood of the collapse for the rest of the pass
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    locked[positionOf[output[3 * adjacency[a] + corner]]] = true;
+                }
+            }
+
+            // each vertex at the collapsed position joins the vertex at the target with the closest attributes
+            for (uint32_t w = wedgeOffsets[collapse.from]; w < wedgeOffsets[collapse.from + 1]; w++) {
+                const Vertex& vertex = vertices[wedges[w]];
+                uint32_t closest = wedges[wedgeOffsets[collapse.to]];
+                float closestDistance = -1.0f;
+                for (uint32_t t = wedgeOffsets[collapse.to]; t < wedgeOffsets[collapse.to + 1]; t++) {
+                    const Vertex& target = vertices[wedges[t]];
+                    glm::vec3 normalOffset = target.normal - vertex.normal;
+                    glm::vec2 uvOffset = target.texCoord - vertex.texCoord;
+                    float distance = glm::dot(normalOffset, normalOffset) + uvOffset.x * uvOffset.x + uvOffset.y * uvOffset.y;
+                    if (closestDistance < 0.0f || distance < closestDistance) {
+                        closest = wedges[t];
+                        closestDistance = distance;
+                    }
+                }
+                vertexRemap[wedges[w]] = closest;
+            }
+
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            trianglesRemoved += removed;
+            collapseCount++;
+        }
+
+        if (collapseCount == 0) {
+            break;
+        }
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t written = 0;
+        for (size_t i = 0; i < output.size(); i += 3) {
+            uint32_t a = resolve(vertexRemap, output[i + 0]);
+            uint32_t b = resolve(vertexRemap, output[i + 1]);
+            uint32_t c = resolve(vertexRemap, output[i + 2]);
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c]) {
+                continue;
+            }
+            output[written++] = a;
+            output[written++] = b;
+            output[written++] = c;
+        }
+        output.resize(written);
+    }
+
+    return static_cast<float>(sqrt(maxError));
+}
@@ -0,0 +1,120 @@
+//
+// Staging buffer definition
+//
+
+#include <StagingBuffer.h>
+
+#include <Utils.h> // utils namespace
+
+#include <algorithm> // max
+
+//////////////////////
+//
+// Create and destroy the staging buffer
+//
+//////////////////////
+
+void StagingBuffer::createStagingBuffer(VulkanSetup* pVkSetup) {
+    vkSetup = pVkSetup;
+
+    // reading uncached memory back is very slow, prefer cached memory if there is any
+    memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(vkSetup->physicalDevice, &deviceMemoryProperties);
+    VkMemoryPropertyFlags cachedProperties = memoryProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
+        if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & cachedProperties) == cachedProperties) {
+            memoryProperties = cachedProperties;
+            break;
+        }
+    }
+
+    blocks.resize(1);
+    createBlock(STAGING_BLOCK_SIZE, blocks[0]);
+}
+
+void StagingBuffer::cleanupStagingBuffer() {
+    for (auto& block : blocks) {
+        if (block.buffer != VK_NULL_HANDLE) {
+            destroyBlock(block);
+        }
+    }
+    blocks.clear();
+}
+
+void StagingBuffer::createBlock(VkDeviceSize size, StagingBlock& block) {
+    utils::createBuffer(&vkSetup->device, &vkSetup->memoryAllocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, memoryProperties, block.buffer, block.memory);
+    // host visible memory stays mapped for as long as the allocator holds it
+    block.mapped = block.memory.mapped;
+    block.size = size;
+    block.used = 0;
+    block.regions = 0;
+}
+
+void StagingBuffer::destroyBlock(StagingBlock& block) {
+    vkDestroyBuffer(vkSetup->device, block.buffer, nullptr);
+    vkSetup->memoryAllocator.free(block.memory);
+    block = StagingBlock{};
+}
+
+//////////////////////
+//
+// Allocate and free regions
+//
+//////////////////////
+
+StagingRegion StagingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // the first block with room left after its last region
+    uint32_t blockIndex = 0;
+    VkDeviceSize offset = 0;
+    for (; blockIndex < blocks.size(); blockIndex++) {
+        const StagingBlock& block = blocks[blockIndex];
+        offset = (block.used + alignment - 1) / alignment * alignment;
+        if (block.buffer != VK_NULL_HANDLE && offset + size <= block.size) {
+            break;
+        }
+    }
+
+    // otherwise a new block, in a free slot if there is one
+    if (blockIndex == blocks.size()) {
+        for (blockIndex = 0; blockIndex < blocks.size() && blocks[blockIndex].buffer != VK_NULL_HANDLE; blockIndex++);
+        if (blockIndex == blocks.size()) {
+            blocks.emplace_back();
+        }
+        createBlock(std::max(size, STAGING_BLOCK_SIZE), blocks[blockIndex]);
+        offset = 0;
+    }
+
+    StagingBlock& block = blocks[blockIndex];
+    block.used = offset + size;
+    block.regions++;
+
+    StagingRegion region;
+    region.buffer = block.buffer;
+    region.offset = offset;
+    region.size = size;
+    region.data = block.mapped + offset;
+    region.block = blockIndex;
+    return region;
+}
+
+void StagingBuffer::free(StagingRegion& region) {
+    if (region.buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    StagingBlock& block = blocks[region.block];
+    if (--block.regions == 0) {
+        // the first block is rewound, the others only served the regions that didn't fit
+        if (region.block == 0) {
+            block.used = 0;
+        }
+        else {
+            destroyBlock(block);
+        }
+    }
+    region = StagingRegion{};
+}
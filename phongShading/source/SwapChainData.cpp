@@ -413,7 +413,7 @@ void SwapChainData::createImGuiRenderPass() {
 
 void SwapChainData::createGraphicsPipeline(VkDescriptorSetLayout* descriptorSetLayout) {
     // std::vector<char> 
-    auto vertShaderCode = Shader::readFile(SHADER_VERT_PATH);
+    auto vertShaderCode = Shader::readFile(usePackedVertices ? SHADER_VERT_PACKED_PATH : SHADER_VERT_PATH);
     auto fragShaderCode = Shader::readFile(SHADER_FRAG_PATH);
 
 
@@ -441,20 +441,42 @@ void SwapChainData::createGraphicsPipeline(VkDescriptorSetLayout* descriptorSetL
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main"; // also use main as the entry point
 
+    // the size of the texture table depends on the device, so it is a specialisation constant of the fragment shader
+    VkSpecializationMapEntry textureTableSizeEntry{};
+    textureTableSizeEntry.constantID = 0;
+    textureTableSizeEntry.offset = 0;
+    textureTableSizeEntry.size = sizeof(uint32_t);
+    VkSpecializationInfo fragSpecializationInfo{};
+    fragSpecializationInfo.mapEntryCount = 1;
+    fragSpecializationInfo.pMapEntries = &textureTableSizeEntry;
+    fragSpecializationInfo.dataSize = sizeof(uint32_t);
+    fragSpecializationInfo.pData = &vkSetup->textureTableSize;
+    fragShaderStageInfo.pSpecializationInfo = &fragSpecializationInfo;
+
     // use this array for future reference
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-    // setup pipeline to accept vertex data
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    // setup pipeline to accept vertex data: the position stream, then the attribute stream in the format chosen at compile time
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions = { VertexPosition::getBindingDescription() };
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions = { VertexPosition::getAttributeDescription() };
+    if (usePackedVertices) {
+        bindingDescriptions.push_back(PackedVertexAttributes::getBindingDescription());
+        auto packedAttributes = PackedVertexAttributes::getAttributeDescriptions();
+        attributeDescriptions.insert(attributeDescriptions.end(), packedAttributes.begin(), packedAttributes.end());
+    }
+    else {
+        bindingDescriptions.push_back(VertexAttributes::getBindingDescription());
+        auto attributes = VertexAttributes::getAttributeDescriptions();
+        attributeDescriptions.insert(attributeDescriptions.end(), attributes.begin(), attributes.end());
+    }
 
     // format of the vertex data, describe the binding and the attributes
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     // because vertex data is in the shader, we don't have to specify anything here. We would otherwise
     // need arrays of structs that describe the details for loading vertex data
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
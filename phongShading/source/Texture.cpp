@@ -5,6 +5,12 @@
 #include <Texture.h>
 
 #include <Utils.h> // utils namespace
+#include <Mipmaps.h> // cpu mip chain
+
+#include <algorithm> // max
+#include <cstring> // memcpy, memset
+#include <filesystem> // path of the compressed texture
+#include <vector> // copy regions, cpu mip chain
 
 // image loading
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,93 +22,436 @@
 //
 //////////////////////
 
-void Texture::createTexture(VulkanSetup* pVkSetup, const std::string& path, const VkCommandPool& commandPool) {
+void Texture::createTexture(VulkanSetup* pVkSetup, SamplerCache* pSamplerCache, StagingBuffer* pStagingBuffer, const std::string& path,
+    UploadBatcher* pUploadBatcher) {
     vkSetup = pVkSetup;
+    samplerCache = pSamplerCache;
+    stagingBuffer = pStagingBuffer;
+    uploadBatcher = pUploadBatcher;
+    // decode the file or read the compressed texture
+    TextureData textureData;
+    loadTextureData(path, {}, textureData);
     // create the image and its memory
-    createTextureImage(path, commandPool);
+    uploadTextureImage(textureData);
     // create the image view
-    textureImageView = utils::createImageView(&vkSetup->device, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    textureImageView = utils::createImageView(&vkSetup->device, textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
     // create the sampler
     createTextureSampler();
 }
 
+void Texture::createTextureAsync(VulkanSetup* pVkSetup, SamplerCache* pSamplerCache, StagingBuffer* pStagingBuffer, const std::string& path,
+    UploadBatcher* pUploadBatcher) {
+    vkSetup = pVkSetup;
+    samplerCache = pSamplerCache;
+    stagingBuffer = pStagingBuffer;
+    uploadBatcher = pUploadBatcher;
+
+    // the placeholder is a single white texel, lit like an untextured model until the texture arrives. It is tiny so
+    // it goes in the current batch with the rest of the loading
+    TextureData placeholder;
+    placeholder.width = 1;
+    placeholder.height = 1;
+    placeholder.staging = stagingBuffer->allocate(4, TEXTURE_STAGING_ALIGNMENT);
+    memset(placeholder.staging.data, 255, 4);
+    placeholder.regions = { levelCopyRegion(0, 1, 1, 0) };
+    uploadTextureImage(placeholder);
+    textureImageView = utils::createImageView(&vkSetup->device, textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    // the sampler doesn't depend on the image, the same one is used for both
+    createTextureSampler();
+
+    // the decoding only reads from the vulkan setup, the upload is left to updateStreaming on this thread
+    decoding = true;
+    decoded = false;
+    decodeThread = std::thread([this, path]() {
+        try {
+            loadTextureData(path, {}, streamedData);
+        }
+        catch (...) {
+            decodeError = std::current_exception();
+        }
+        decoded.store(true, std::memory_order_release);
+    });
+}
+
+bool Texture::updateStreaming() {
+    if (decoding) {
+        if (!decoded.load(std::memory_order_acquire)) {
+            return false;
+        }
+        decodeThread.join();
+        decoding = false;
+        // a texture that can't be loaded fails the same way it does when loaded synchronously
+        if (decodeError) {
+            std::rethrow_exception(decodeError);
+        }
+        submitStreamedUpload();
+        return false;
+    }
+
+    // the batch frees the staging region once it is done
+    if (!uploading || !uploadBatcher->isComplete(streamingUpload)) {
+        return false;
+    }
+    uploading = false;
+
+    // swap the texture in
+    placeholderImage = textureImage;
+    placeholderImageView = textureImageView;
+    placeholderImageMemory = textureImageMemory;
+    textureImage = streamedImage;
+    textureImageMemory = streamedImageMemory;
+    textureFormat = streamedData.format;
+    mipLevels = streamedData.mipLevels;
+    textureImageView = utils::createImageView(&vkSetup->device, textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    streamedImage = VK_NULL_HANDLE;
+    streamedImageMemory = MemoryAllocation{};
+    streamedData = TextureData{};
+
+    return true;
+}
+
 void Texture::cleanupTexture() {
-    // destroy the texture image view and sampler
-    vkDestroySampler(vkSetup->device, textureSampler, nullptr);
+    // a texture still streaming in, the decoding can't be interrupted
+    if (decoding) {
+        decodeThread.join();
+        stagingBuffer->free(streamedData.staging);
+        decoding = false;
+    }
+    if (uploading) {
+        uploadBatcher->wait(streamingUpload);
+        vkDestroyImage(vkSetup->device, streamedImage, nullptr);
+        vkSetup->memoryAllocator.free(streamedImageMemory);
+        uploading = false;
+    }
+    if (placeholderImage != VK_NULL_HANDLE) {
+        vkDestroyImageView(vkSetup->device, placeholderImageView, nullptr);
+        vkDestroyImage(vkSetup->device, placeholderImage, nullptr);
+        vkSetup->memoryAllocator.free(placeholderImageMemory);
+        placeholderImage = VK_NULL_HANDLE;
+    }
+
+    // release the sampler and destroy the texture image view
+    samplerCache->releaseSampler(textureSampler);
     vkDestroyImageView(vkSetup->device, textureImageView, nullptr);
 
     // destroy the texture image and its memory
     vkDestroyImage(vkSetup->device, textureImage, nullptr);
-    vkFreeMemory(vkSetup->device, textureImageMemory, nullptr);
+    vkSetup->memoryAllocator.free(textureImageMemory);
 }
 
 //////////////////////
 //
-// Texture image and sampler
+// Batched loading
+//
+//////////////////////
+
+void Texture::decodeTexture(VulkanSetup* pVkSetup, SamplerCache* pSamplerCache, StagingBuffer* pStagingBuffer, const std::string& path,
+    const std::vector<uint8_t>& fileContent, TextureData& textureData) {
+    vkSetup = pVkSetup;
+    samplerCache = pSamplerCache;
+    stagingBuffer = pStagingBuffer;
+    loadTextureData(path, fileContent, textureData);
+}
+
+void Texture::recordBatchedUpload(TextureData& textureData, UploadBatcher* pUploadBatcher) {
+    uploadBatcher = pUploadBatcher;
+    uploadTextureImage(textureData);
+
+    // the view and sampler don't need the upload to be done
+    textureImageView = utils::createImageView(&vkSetup->device, textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    createTextureSampler();
+}
+
+//////////////////////
+//
+// Texture data
 //
 //////////////////////
 
-void Texture::createTextureImage(const std::string& path, const VkCommandPool& commandPool) {
-    // uses command buffer so should be called after create command pool
+void Texture::loadTextureData(const std::string& path, const std::vector<uint8_t>& fileContent, TextureData& textureData) {
+    // the levels of a ktx2 file are read straight into the staging buffer
+    auto allocateStaging = [&](VkDeviceSize size) {
+        textureData.staging = stagingBuffer->allocate(size, TEXTURE_STAGING_ALIGNMENT);
+        return textureData.staging.data;
+    };
+
+    try {
+        // a ktx2 file is used as is, it has to be in a format the device can sample
+        std::filesystem::path sourcePath(path);
+        if (sourcePath.extension() == KTX2_EXTENSION) {
+            Ktx2Texture compressed;
+            ktx2::loadKtx2(path, compressed, allocateStaging);
+            if (!isFormatSupported(compressed.format)) {
+                throw std::runtime_error("failed to load texture image, the device can't sample the format of " + path + "!");
+            }
+            loadCompressedTextureData(compressed, textureData);
+            return;
+        }
+
+        // otherwise the compressed version next to the image is preferred when there is one the device can sample, it has
+        // its mip chain already and no decoding to do
+        std::string compressedPath = sourcePath.replace_extension(KTX2_EXTENSION).string();
+        if (useCompressedTextures && std::filesystem::exists(compressedPath)) {
+            Ktx2Texture compressed;
+            ktx2::loadKtx2(compressedPath, compressed, allocateStaging);
+            if (isFormatSupported(compressed.format)) {
+                loadCompressedTextureData(compressed, textureData);
+                return;
+            }
+            stagingBuffer->free(textureData.staging);
+        }
+
+        loadUncompressedTextureData(path, fileContent, textureData);
+    }
+    catch (...) {
+        // a texture that fails to load must not keep its part of the staging buffer
+        stagingBuffer->free(textureData.staging);
+        throw;
+    }
+}
+
+bool Texture::isFormatSupported(VkFormat format) {
+    // the BC formats need the feature to be enabled on top of the format being sampleable
+    if (ktx2::isSupportedFormat(format) && !vkSetup->textureCompressionBC) {
+        return false;
+    }
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(vkSetup->physicalDevice, format, &formatProperties);
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+void Texture::loadCompressedTextureData(const Ktx2Texture& compressed, TextureData& textureData) {
+    textureData.format = compressed.format;
+    textureData.width = compressed.width;
+    textureData.height = compressed.height;
+    textureData.mipLevels = compressed.levelCount;
+    textureData.blitMipmaps = false;
+
+    // the blocks are copied as they are, every level comes from the file
+    textureData.regions.resize(compressed.levelCount);
+    for (uint32_t level = 0; level < compressed.levelCount; level++) {
+        textureData.regions[level] = levelCopyRegion(level, compressed.width, compressed.height, compressed.levelOffsets[level]);
+    }
+}
+
+void Texture::loadUncompressedTextureData(const std::string& path, const std::vector<uint8_t>& fileContent, TextureData& textureData) {
     int texWidth, texHeight, texChannels;
 
-    // load the file 
+    // load the file, or decode it from memory if it has been read already
     // forces image to be loaded with an alpha channel, returns ptr to first element in an array of pixels
-    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    // laid out row by row with 4 bytes by pixel in case of STBI_rgb_alpha
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+    stbi_uc* pixels = fileContent.empty() ? stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha)
+        : stbi_load_from_memory(fileContent.data(), static_cast<int>(fileContent.size()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     if (!pixels) {
         throw std::runtime_error("failed to load texture image!");
     }
+    uint32_t width = static_cast<uint32_t>(texWidth);
+    uint32_t height = static_cast<uint32_t>(texHeight);
+    // laid out row by row with 4 bytes by pixel in case of STBI_rgb_alpha
+    size_t levelSize = (size_t)width * height * 4;
 
-    // create a staging buffer in host visible memory so we can map it, not device memory although that is our destination
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    textureData.format = VK_FORMAT_R8G8B8A8_SRGB;
+    textureData.width = width;
+    textureData.height = height;
+    // the full chain, so that minified texels are read from a level of about their size rather than from all over
+    // the full resolution image
+    textureData.mipLevels = mipmaps::levelCount(width, height);
 
-    utils::createBuffer(&vkSetup->device, &vkSetup->physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
+    // the gpu makes the chain with blits if it can filter the format linearly, otherwise it is made on the cpu and
+    // uploaded with the image
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(vkSetup->physicalDevice, textureData.format, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    textureData.blitMipmaps = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
 
-    // directly copy the pixels in the array from the image loading library to the buffer
-    void* data;
-    vkMapMemory(vkSetup->device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(vkSetup->device, stagingBufferMemory);
+    // stb_image can't decode into memory it is given, so its pixels are copied to the staging buffer once. There the
+    // rest of the chain is built in place
+    if (textureData.blitMipmaps) {
+        // only the first level is copied
+        textureData.staging = stagingBuffer->allocate(levelSize, TEXTURE_STAGING_ALIGNMENT);
+        memcpy(textureData.staging.data, pixels, levelSize);
+        textureData.regions = { levelCopyRegion(0, width, height, 0) };
+        stbi_image_free(pixels);
+        return;
+    }
 
-    // and cleanup pixels after copying in the data
+    textureData.staging = stagingBuffer->allocate(mipmaps::chainSize(width, height, textureData.mipLevels), TEXTURE_STAGING_ALIGNMENT);
+    memcpy(textureData.staging.data, pixels, levelSize);
     stbi_image_free(pixels);
+    mipmaps::generateChain(textureData.staging.data, width, height, textureData.mipLevels, true);
+
+    // every level is copied, one region each
+    textureData.regions.resize(textureData.mipLevels);
+    for (uint32_t level = 0; level < textureData.mipLevels; level++) {
+        textureData.regions[level] = levelCopyRegion(level, width, height, mipmaps::chainSize(width, height, level));
+    }
+}
+
+VkBufferImageCopy Texture::levelCopyRegion(uint32_t level, uint32_t width, uint32_t height, VkDeviceSize bufferOffset) {
+    VkBufferImageCopy region{};
+    region.bufferOffset = bufferOffset;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    // in texels, for block compressed formats the partial blocks of small levels are clipped to the level size
+    region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+    return region;
+}
 
-    // now create the image
+//////////////////////
+//
+// Texture image and sampler
+//
+//////////////////////
+
+void Texture::createTextureImage(const TextureData& textureData, VkImage& image, MemoryAllocation& imageMemory) {
+    // the levels are read from when blitting the next ones
     CreateImageData info{};
-    info.width = texWidth;
-    info.height = texHeight;
-    info.format = VK_FORMAT_R8G8B8A8_SRGB;
+    info.width = textureData.width;
+    info.height = textureData.height;
+    info.mipLevels = textureData.mipLevels;
+    info.format = textureData.format;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.usage = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (textureData.blitMipmaps ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
     info.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    info.image = &textureImage;
-    info.imageMemory = &textureImageMemory;
-    utils::createImage(&vkSetup->device, &vkSetup->physicalDevice, info);
-
-    // next step is to copy the staging buffer to the texture image using our helper functions
-    TransitionImageLayoutData transitionData{};
-    transitionData.image = &textureImage;
-    transitionData.renderCommandPool = commandPool;
-    transitionData.format = VK_FORMAT_R8G8B8A8_SRGB;
-    transitionData.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    transitionData.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    utils::transitionImageLayout(&vkSetup->device, &vkSetup->graphicsQueue, transitionData); // specify the initial layout VK_IMAGE_LAYOUT_UNDEFINED
-    utils::copyBufferToImage(&vkSetup->device, &vkSetup->graphicsQueue, commandPool, stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    // need another transfer to give the shader access to the texture
-    transitionData.image = &textureImage;
-    transitionData.renderCommandPool = commandPool;
-    transitionData.format = VK_FORMAT_R8G8B8A8_SRGB;
-    transitionData.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    transitionData.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    utils::transitionImageLayout(&vkSetup->device, &vkSetup->graphicsQueue, transitionData);
-
-    // cleanup the staging buffer and its memory
-    vkDestroyBuffer(vkSetup->device, stagingBuffer, nullptr);
-    vkFreeMemory(vkSetup->device, stagingBufferMemory, nullptr);
+    info.image = &image;
+    info.imageMemory = &imageMemory;
+    utils::createImage(&vkSetup->device, &vkSetup->memoryAllocator, info);
+}
+
+void Texture::recordTextureUpload(UploadBatcher* uploadBatcher, const TextureData& textureData, VkImage image) {
+    // the copy goes on the transfer queue if there is one
+    VkCommandBuffer commandBuffer = uploadBatcher->recordTransfer();
+
+    // every level becomes a transfer destination, from the copy or from the blits
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = textureData.mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // the regions are relative to the start of the texture data, which isn't the start of the staging buffer
+    std::vector<VkBufferImageCopy> regions = textureData.regions;
+    for (VkBufferImageCopy& region : regions) {
+        region.bufferOffset += textureData.staging.offset;
+    }
+    vkCmdCopyBufferToImage(commandBuffer, textureData.staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+    if (textureData.blitMipmaps) {
+        // blits need the graphics queue, the image is handed over to it as a transfer destination
+        uploadBatcher->transferImageOwnership(image, barrier.subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        recordMipmapBlits(uploadBatcher->recordGraphics(), image, textureData.width, textureData.height, textureData.mipLevels);
+    }
+    else {
+        // need another transfer to give the shader access to the texture, on the graphics queue
+        uploadBatcher->transferImageOwnership(image, barrier.subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+}
+
+void Texture::uploadTextureImage(TextureData& textureData) {
+    createTextureImage(textureData, textureImage, textureImageMemory);
+    textureFormat = textureData.format;
+    mipLevels = textureData.mipLevels;
+
+    // the layout transitions, the copy and the blits go in the batch of the loading phase, which is submitted once.
+    // The staging region is reused once the batch is done
+    recordTextureUpload(uploadBatcher, textureData, textureImage);
+    uploadBatcher->freeAfterUpload(textureData.staging);
+}
+
+void Texture::submitStreamedUpload() {
+    createTextureImage(streamedData, streamedImage, streamedImageMemory);
+
+    recordTextureUpload(uploadBatcher, streamedData, streamedImage);
+    uploadBatcher->freeAfterUpload(streamedData.staging);
+
+    // the ticket of the batch is polled by updateStreaming instead of waiting for the queue to be idle
+    streamingUpload = uploadBatcher->submit();
+    uploading = true;
+}
+
+void Texture::recordMipmapBlits(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels) {
+    // one level at a time
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t levelWidth = static_cast<int32_t>(width);
+    int32_t levelHeight = static_cast<int32_t>(height);
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        // the previous level has been written, wait for it and make it the source of the blit
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        // the whole of the previous level scaled down into the whole of this one, filtered linearly (in linear space for
+        // sRGB formats)
+        int32_t nextWidth = std::max(levelWidth / 2, 1);
+        int32_t nextHeight = std::max(levelHeight / 2, 1);
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { levelWidth, levelHeight, 1 };
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    // all the levels are handed to the fragment shader at once: the ones that were blitted from are transfer sources,
+    // the last one is still a transfer destination
+    VkImageMemoryBarrier finalBarriers[2] = { barrier, barrier };
+    finalBarriers[0].subresourceRange.baseMipLevel = 0;
+    finalBarriers[0].subresourceRange.levelCount = mipLevels - 1;
+    finalBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    finalBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    finalBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    finalBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    finalBarriers[1].subresourceRange.baseMipLevel = mipLevels - 1;
+    finalBarriers[1].subresourceRange.levelCount = 1;
+    finalBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    finalBarriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    finalBarriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    finalBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // a 1x1 texture has no level that was blitted from
+    uint32_t firstBarrier = mipLevels > 1 ? 0 : 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+        2 - firstBarrier, finalBarriers + firstBarrier);
 }
 
 void Texture::createTextureSampler() {
@@ -123,10 +472,8 @@ void Texture::createTextureSampler() {
     // VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER : Return a solid color when sampling beyond the dimensions of the image
 
     samplerInfo.anisotropyEnable = VK_TRUE; // use unless performance is a concern (IT WILL BE)
-    VkPhysicalDeviceProperties properties{}; // can query these here or at beginning for reference
-    vkGetPhysicalDeviceProperties(vkSetup->physicalDevice, &properties);
     // limites the amount of texel samples that can be used to calculate final colours, obtain from the device properties
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+    samplerInfo.maxAnisotropy = vkSetup->deviceProperties.limits.maxSamplerAnisotropy;
     // self ecplanatory, can't be an arbitrary colour
     samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE; // which coordinate system we want to use to address texels! usually always normalised
@@ -137,10 +484,8 @@ void Texture::createTextureSampler() {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // every level of the view, which has the whole chain
 
-    // now create the configured sampler
-    if (vkCreateSampler(vkSetup->device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create texture sampler!");
-    }
+    // the textures sampled the same way share a sampler, it is only created for the first one
+    textureSampler = samplerCache->acquireSampler(samplerInfo);
 }
\ No newline at end of file
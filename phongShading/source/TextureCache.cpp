@@ -0,0 +1,191 @@
+//
+// Texture cache definition
+//
+
+#include <TextureCache.h>
+
+#include <Parallel.h> // concurrent reading and decoding
+
+#include <chrono> // stage timing
+#include <fstream> // file input
+#include <stdexcept> // runtime_error
+#include <unordered_set> // the images of a batch
+
+//////////////////////
+//
+// Cache key
+//
+//////////////////////
+
+void TextureCache::readFile(const std::string& path, std::vector<uint8_t>& content) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open texture image " + path + "!");
+    }
+    content.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(content.data()), static_cast<std::streamsize>(content.size()))) {
+        throw std::runtime_error("failed to read texture image " + path + "!");
+    }
+}
+
+TextureKey TextureCache::makeKey(const std::vector<uint8_t>& content) {
+    // 64 bit FNV-1a hash of the whole file
+    TextureKey key{ 0xcbf29ce484222325ull, content.size() };
+    for (uint8_t byte : content) {
+        key.contentHash ^= byte;
+        key.contentHash *= 0x100000001b3ull;
+    }
+    return key;
+}
+
+//////////////////////
+//
+// Acquire and release textures
+//
+//////////////////////
+
+void TextureCache::createTextureCache(VulkanSetup* pVkSetup, StagingBuffer* pStagingBuffer, UploadBatcher* pUploadBatcher) {
+    vkSetup = pVkSetup;
+    stagingBuffer = pStagingBuffer;
+    uploadBatcher = pUploadBatcher;
+    samplerCache.createSamplerCache(pVkSetup);
+}
+
+Texture* TextureCache::acquireTexture(const std::string& path, bool stream) {
+    // the file is read again when it is decoded but by then it is in the os cache
+    std::vector<uint8_t> content;
+    readFile(path, content);
+    TextureKey key = makeKey(content);
+
+    // the same image was already loaded, possibly from another path
+    auto cached = textures.find(key);
+    if (cached != textures.end()) {
+        cached->second.refCount++;
+        return cached->second.texture.get();
+    }
+
+    std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+    if (stream) {
+        texture->createTextureAsync(vkSetup, &samplerCache, stagingBuffer, path, uploadBatcher);
+    }
+    else {
+        texture->createTexture(vkSetup, &samplerCache, stagingBuffer, path, uploadBatcher);
+    }
+
+    Texture* handle = texture.get();
+    textures[key] = { std::move(texture), 1, stream };
+    textureKeys[handle] = key;
+    return handle;
+}
+
+std::vector<Texture*> TextureCache::acquireTextures(const std::vector<std::string>& paths) {
+    batchStats = TextureBatchStats{};
+    batchStats.textureCount = paths.size();
+
+    // read and hash every file, the files are kept in memory for decoding
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<uint8_t>> contents(paths.size());
+    std::vector<TextureKey> keys(paths.size());
+    parallel::parallelFor(paths.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; i++) {
+            readFile(paths[i], contents[i]);
+            keys[i] = makeKey(contents[i]);
+        }
+    });
+    batchStats.ioTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // the paths of images that aren't loaded yet, once each
+    std::vector<size_t> created;
+    std::unordered_set<TextureKey, TextureKeyHash> batchKeys;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (textures.count(keys[i]) == 0 && batchKeys.insert(keys[i]).second) {
+            created.push_back(i);
+        }
+    }
+    batchStats.createdCount = created.size();
+
+    // decode them on all cores straight into the staging buffer, each texture is decoded by a single worker. Nothing is
+    // added to the cache until every texture is decoded so that a file failing to load leaves the cache as it was
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<std::unique_ptr<Texture>> newTextures(created.size());
+    std::vector<TextureData> textureData(created.size());
+    try {
+        parallel::parallelFor(created.size(), [&](size_t begin, size_t end, uint32_t) {
+            for (size_t i = begin; i < end; i++) {
+                newTextures[i] = std::make_unique<Texture>();
+                newTextures[i]->decodeTexture(vkSetup, &samplerCache, stagingBuffer, paths[created[i]], contents[created[i]], textureData[i]);
+                // the encoded file isn't needed any more
+                contents[created[i]] = std::vector<uint8_t>();
+            }
+        });
+    }
+    catch (...) {
+        for (TextureData& data : textureData) {
+            stagingBuffer->free(data.staging);
+        }
+        throw;
+    }
+    batchStats.decodeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    if (!created.empty()) {
+        // every upload in the command buffer of the current batch, the staging regions are freed once it is done
+        for (size_t i = 0; i < created.size(); i++) {
+            batchStats.uploadedBytes += static_cast<size_t>(textureData[i].staging.size);
+            newTextures[i]->recordBatchedUpload(textureData[i], uploadBatcher);
+        }
+    }
+    batchStats.recordTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // the new textures are cached, then every path acquires its texture
+    for (size_t i = 0; i < created.size(); i++) {
+        Texture* handle = newTextures[i].get();
+        textures[keys[created[i]]] = { std::move(newTextures[i]), 0, false };
+        textureKeys[handle] = keys[created[i]];
+    }
+    std::vector<Texture*> acquired(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        CachedTexture& cached = textures[keys[i]];
+        cached.refCount++;
+        acquired[i] = cached.texture.get();
+    }
+    return acquired;
+}
+
+void TextureCache::releaseTexture(Texture* texture) {
+    auto textureKey = textureKeys.find(texture);
+    if (textureKey == textureKeys.end()) {
+        throw std::runtime_error("failed to release texture, it was not acquired from the cache!");
+    }
+
+    auto cached = textures.find(textureKey->second);
+    if (--cached->second.refCount > 0) {
+        return;
+    }
+    texture->cleanupTexture();
+    textures.erase(cached);
+    textureKeys.erase(textureKey);
+}
+
+bool TextureCache::updateStreaming() {
+    bool swapped = false;
+    for (auto& cached : textures) {
+        if (cached.second.streaming && cached.second.texture->updateStreaming()) {
+            cached.second.streaming = false;
+            swapped = true;
+        }
+    }
+    return swapped;
+}
+
+void TextureCache::cleanupTextureCache() {
+    for (auto& cached : textures) {
+        cached.second.texture->cleanupTexture();
+    }
+    textures.clear();
+    textureKeys.clear();
+
+    // after the textures, which release their samplers
+    samplerCache.cleanupSamplerCache();
+}
@@ -0,0 +1,113 @@
+//
+// Definition of the offline texture cooker
+//
+
+#include <TextureCooker.h>
+
+#include <Ktx2.h> // ktx2 writing
+#include <Mipmaps.h> // cpu mip chain
+#include <BlockCompression.h> // BC1 and BC7 encoding
+#include <Parallel.h> // worker count
+
+#include <algorithm> // max
+#include <chrono> // stage timing
+#include <cmath> // log10
+#include <cstring> // memcpy
+#include <iostream> // report
+#include <stdexcept> // runtime_error
+#include <vector> // vector container
+
+// image loading, the implementation is in Texture.cpp
+#include <stb_image.h>
+
+//////////////////////
+//
+// Cooking
+//
+//////////////////////
+
+VkFormat texturecooker::formatFromName(const std::string& name) {
+    if (name == "bc1") {
+        return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    }
+    if (name == "bc7") {
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+    throw std::runtime_error("failed to cook texture, unknown format " + name + ", expected bc1 or bc7!");
+}
+
+void texturecooker::cookTexture(const std::string& sourcePath, const std::string& outputPath, VkFormat format, uint32_t refinements) {
+    bool bc1 = format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    std::cout << "cooking " << sourcePath << " to " << (bc1 ? "BC1" : "BC7") << ", " << refinements << " refinements, "
+        << parallel::workerCount() << " workers" << std::endl;
+
+    // decode
+    auto start = std::chrono::high_resolution_clock::now();
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load(sourcePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error("failed to load texture image " + sourcePath + "!");
+    }
+    uint32_t width = static_cast<uint32_t>(texWidth);
+    uint32_t height = static_cast<uint32_t>(texHeight);
+    uint32_t levelCount = mipmaps::levelCount(width, height);
+    std::vector<uint8_t> chain(mipmaps::chainSize(width, height, levelCount));
+    memcpy(chain.data(), pixels, (size_t)width * height * 4);
+    stbi_image_free(pixels);
+    float decodeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // the same chain the texture builds when it can't blit, filtered in linear space
+    start = std::chrono::high_resolution_clock::now();
+    mipmaps::generateChain(chain.data(), width, height, levelCount, true);
+    float mipmapTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // encode the levels one after the other, the rows of blocks of each level are split between the workers
+    Ktx2Texture texture;
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.levelCount = levelCount;
+    texture.levelOffsets.resize(levelCount);
+    VkDeviceSize dataSize = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        texture.levelOffsets[level] = dataSize;
+        dataSize += ktx2::levelSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u));
+    }
+    texture.data.resize(static_cast<size_t>(dataSize));
+
+    start = std::chrono::high_resolution_clock::now();
+    for (uint32_t level = 0; level < levelCount; level++) {
+        blockcompression::compressLevel(chain.data() + mipmaps::chainSize(width, height, level), std::max(width >> level, 1u), std::max(height >> level, 1u),
+            format, refinements, texture.data.data() + texture.levelOffsets[level]);
+    }
+    float encodeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    ktx2::writeKtx2(outputPath, texture);
+    float writeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // decode the blocks back to measure the loss, BC1 has no alpha so only the colour channels are compared
+    std::vector<uint8_t> decoded(chain.size());
+    for (uint32_t level = 0; level < levelCount; level++) {
+        blockcompression::decompressLevel(texture.data.data() + texture.levelOffsets[level], std::max(width >> level, 1u), std::max(height >> level, 1u),
+            format, decoded.data() + mipmaps::chainSize(width, height, level));
+    }
+    uint32_t channels = bc1 ? 3 : 4;
+    double squaredError = 0.0;
+    for (size_t texel = 0; texel < chain.size() / 4; texel++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            double difference = (double)chain[4 * texel + c] - decoded[4 * texel + c];
+            squaredError += difference * difference;
+        }
+    }
+    double meanSquaredError = squaredError / ((double)(chain.size() / 4) * channels);
+    double psnr = meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+
+    double megapixels = (double)(chain.size() / 4) / 1e6;
+    std::cout << "    " << width << "x" << height << ", " << levelCount << " levels, " << chain.size() / 1024 << " KB -> " << texture.data.size() / 1024 << " KB" << std::endl;
+    std::cout << "    decode:  " << decodeTime << " ms" << std::endl;
+    std::cout << "    mipmaps: " << mipmapTime << " ms" << std::endl;
+    std::cout << "    encode:  " << encodeTime << " ms (" << megapixels / (encodeTime / 1000.0) << " MPix/s)" << std::endl;
+    std::cout << "    write:   " << writeTime << " ms" << std::endl;
+    std::cout << "    PSNR:    " << psnr << " dB" << std::endl;
+}
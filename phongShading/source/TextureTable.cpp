@@ -0,0 +1,94 @@
+//
+// Texture table definition
+//
+
+#include <TextureTable.h>
+
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Add and remove textures
+//
+//////////////////////
+
+void TextureTable::createTextureTable(VulkanSetup* pVkSetup) {
+    vkSetup = pVkSetup;
+    slots.assign(vkSetup->textureTableSize, TableSlot{});
+}
+
+uint32_t TextureTable::addTexture(Texture* texture) {
+    // already in the table, from another material
+    auto textureSlot = textureSlots.find(texture);
+    if (textureSlot != textureSlots.end()) {
+        slots[textureSlot->second].refCount++;
+        return textureSlot->second;
+    }
+
+    for (uint32_t slot = 0; slot < slots.size(); slot++) {
+        if (slots[slot].texture == nullptr) {
+            slots[slot] = { texture, 1 };
+            textureSlots[texture] = slot;
+            return slot;
+        }
+    }
+    throw std::runtime_error("failed to add texture to the texture table, all " + std::to_string(slots.size()) + " slots are used!");
+}
+
+void TextureTable::removeTexture(Texture* texture) {
+    auto textureSlot = textureSlots.find(texture);
+    if (textureSlot == textureSlots.end()) {
+        throw std::runtime_error("failed to remove texture, it is not in the texture table!");
+    }
+
+    TableSlot& slot = slots[textureSlot->second];
+    if (--slot.refCount > 0) {
+        return;
+    }
+    slot = TableSlot{};
+    textureSlots.erase(textureSlot);
+}
+
+void TextureTable::cleanupTextureTable() {
+    // the textures belong to the texture cache
+    slots.clear();
+    textureSlots.clear();
+}
+
+//////////////////////
+//
+// Descriptors
+//
+//////////////////////
+
+void TextureTable::writeDescriptors(VkDescriptorSet set, uint32_t binding) const {
+    const Texture* fallback = nullptr;
+    for (const TableSlot& slot : slots) {
+        if (slot.texture != nullptr) {
+            fallback = slot.texture;
+            break;
+        }
+    }
+    if (fallback == nullptr) {
+        throw std::runtime_error("failed to write texture table descriptors, the table is empty!");
+    }
+
+    // the whole array in a single write, a streamed texture still shows its placeholder view until it is written again
+    std::vector<VkDescriptorImageInfo> imageInfos(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        const Texture* texture = slots[i].texture != nullptr ? slots[i].texture : fallback;
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[i].imageView = texture->textureImageView;
+        imageInfos[i].sampler = texture->textureSampler;
+    }
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+    descriptorWrite.pImageInfo = imageInfos.data();
+    vkUpdateDescriptorSets(vkSetup->device, 1, &descriptorWrite, 0, nullptr);
+}
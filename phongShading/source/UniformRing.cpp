@@ -0,0 +1,65 @@
+//
+// Uniform ring definition
+//
+
+#include <UniformRing.h>
+
+#include <Utils.h> // utils namespace
+
+#include <algorithm> // max
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Create and destroy the ring
+//
+//////////////////////
+
+void UniformRing::createUniformRing(VulkanSetup* pVkSetup, uint32_t sliceCount) {
+    vkSetup = pVkSetup;
+    this->sliceCount = sliceCount;
+
+    // dynamic offsets must be multiples of the alignment, which is a power of two
+    alignment = std::max(vkSetup->deviceProperties.limits.minUniformBufferOffsetAlignment, VkDeviceSize(16));
+
+    // host coherent so the writes are visible to the gpu without flushing, the block stays mapped
+    utils::createBuffer(&vkSetup->device, &vkSetup->memoryAllocator, UNIFORM_RING_SLICE_SIZE * sliceCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory);
+
+    beginSlice(0);
+}
+
+void UniformRing::cleanupUniformRing() {
+    vkDestroyBuffer(vkSetup->device, buffer, nullptr);
+    vkSetup->memoryAllocator.free(bufferMemory);
+}
+
+//////////////////////
+//
+// Allocate uniforms
+//
+//////////////////////
+
+void UniformRing::beginSlice(uint32_t slice) {
+    sliceStart = UNIFORM_RING_SLICE_SIZE * (slice % sliceCount);
+    sliceEnd = sliceStart + UNIFORM_RING_SLICE_SIZE;
+    head = sliceStart;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size) {
+    VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > sliceEnd) {
+        throw std::runtime_error("failed to allocate uniforms, the slice of the uniform ring is full!");
+    }
+    head = offset + size;
+
+    UniformAllocation allocation;
+    allocation.offset = static_cast<uint32_t>(offset);
+    allocation.data = bufferMemory.mapped + offset;
+    return allocation;
+}
+
+uint32_t UniformRing::sliceOffset(uint32_t slice) const {
+    // the slices are a multiple of the alignment apart, so the first allocation is at the start of the slice
+    return static_cast<uint32_t>(UNIFORM_RING_SLICE_SIZE * (slice % sliceCount));
+}
@@ -0,0 +1,279 @@
+//
+// Upload batcher definition
+//
+
+#include <UploadBatcher.h>
+
+#include <Utils.h> // utils namespace
+
+#include <algorithm> // remove_if
+#include <stdexcept> // runtime_error
+
+//////////////////////
+//
+// Create and destroy the batcher
+//
+//////////////////////
+
+void UploadBatcher::createUploadBatcher(VulkanSetup* pVkSetup, StagingBuffer* pStagingBuffer, const VkCommandPool& commandPool) {
+    vkSetup = pVkSetup;
+    stagingBuffer = pStagingBuffer;
+    this->commandPool = commandPool;
+    recording = UploadBatch{};
+    recording.ticket = nextTicket++;
+
+    // a command pool can only allocate command buffers for the queues of one family
+    if (hasTransferQueue()) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = vkSetup->transferFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // each command buffer is recorded once and freed
+        if (vkCreateCommandPool(vkSetup->device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer command pool!");
+        }
+    }
+}
+
+void UploadBatcher::cleanupUploadBatcher() {
+    submit();
+    for (UploadBatch& batch : pending) {
+        waitForBatch(batch);
+        retireBatch(batch);
+    }
+    pending.clear();
+
+    if (transferCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(vkSetup->device, transferCommandPool, nullptr);
+        transferCommandPool = VK_NULL_HANDLE;
+    }
+}
+
+bool UploadBatcher::hasTransferQueue() const {
+    return vkSetup->transferFamily != vkSetup->graphicsFamily;
+}
+
+//////////////////////
+//
+// Record and submit batches
+//
+//////////////////////
+
+VkCommandBuffer UploadBatcher::recordTransfer() {
+    if (!hasTransferQueue()) {
+        return recordGraphics();
+    }
+    if (recording.transferCommandBuffer == VK_NULL_HANDLE) {
+        recording.transferCommandBuffer = utils::beginSingleTimeCommands(&vkSetup->device, transferCommandPool);
+    }
+    return recording.transferCommandBuffer;
+}
+
+VkCommandBuffer UploadBatcher::recordGraphics() {
+    if (recording.commandBuffer == VK_NULL_HANDLE) {
+        recording.commandBuffer = utils::beginSingleTimeCommands(&vkSetup->device, commandPool);
+    }
+    return recording.commandBuffer;
+}
+
+void UploadBatcher::transferBufferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    if (!hasTransferQueue()) {
+        return;
+    }
+
+    // the same barrier is recorded on both queues, the release makes the copies available and the acquire makes them
+    // visible. The acquire is only submitted once the copies are done, so it has nothing to wait for on the graphics queue
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = vkSetup->transferFamily;
+    barrier.dstQueueFamilyIndex = vkSetup->graphicsFamily;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(recordTransfer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(recordGraphics(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void UploadBatcher::transferImageOwnership(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    // on the one queue, the layout transition waits for the copies
+    if (!hasTransferQueue()) {
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(recordGraphics(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        return;
+    }
+
+    // otherwise the release and the acquire both have the layout transition, which happens once between them
+    barrier.srcQueueFamilyIndex = vkSetup->transferFamily;
+    barrier.dstQueueFamilyIndex = vkSetup->graphicsFamily;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(recordTransfer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(recordGraphics(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadBatcher::freeAfterUpload(StagingRegion& region) {
+    if (region.buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    // the region belongs to a batch that will be submitted
+    recordGraphics();
+    recording.stagingRegions.push_back(region);
+    region = StagingRegion{};
+}
+
+uint64_t UploadBatcher::submit() {
+    // nothing recorded since the last submit, which is the last batch to wait for
+    if (recording.commandBuffer == VK_NULL_HANDLE && recording.transferCommandBuffer == VK_NULL_HANDLE) {
+        return recording.ticket - 1;
+    }
+
+    // the buffers written by the copies are read as vertices, indices, uniforms or storage buffers by the commands that
+    // follow. The images are handed to the fragment shader by their own barriers
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(recordGraphics(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(recording.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(vkSetup->device, &fenceInfo, nullptr, &recording.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload fence!");
+    }
+
+    // the copies are submitted with a fence of their own. The graphics part, which acquires what they wrote, is held
+    // back until update() sees that fence signaled, rather than waiting for them at the front of the graphics queue
+    // where every frame submitted after it would wait too
+    if (recording.transferCommandBuffer != VK_NULL_HANDLE) {
+        if (vkEndCommandBuffer(recording.transferCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record transfer command buffer!");
+        }
+
+        if (vkCreateFence(vkSetup->device, &fenceInfo, nullptr, &recording.transferFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer fence!");
+        }
+
+        VkSubmitInfo transferSubmitInfo{};
+        transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmitInfo.commandBufferCount = 1;
+        transferSubmitInfo.pCommandBuffers = &recording.transferCommandBuffer;
+        if (vkQueueSubmit(vkSetup->transferQueue, 1, &transferSubmitInfo, recording.transferFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit transfer command buffer!");
+        }
+    }
+    else {
+        submitGraphics(recording);
+    }
+
+    uint64_t ticket = recording.ticket;
+    pending.push_back(std::move(recording));
+    recording = UploadBatch{};
+    recording.ticket = nextTicket++;
+    return ticket;
+}
+
+void UploadBatcher::submitGraphics(UploadBatch& batch) {
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    if (vkQueueSubmit(vkSetup->graphicsQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+    batch.graphicsSubmitted = true;
+}
+
+//////////////////////
+//
+// Batch completion
+//
+//////////////////////
+
+void UploadBatcher::update() {
+    for (UploadBatch& batch : pending) {
+        // the copies are done, the graphics queue can acquire what they wrote. Submitted before the frame that calls this
+        if (!batch.graphicsSubmitted && vkGetFenceStatus(vkSetup->device, batch.transferFence) == VK_SUCCESS) {
+            submitGraphics(batch);
+        }
+        if (batch.graphicsSubmitted && vkGetFenceStatus(vkSetup->device, batch.fence) == VK_SUCCESS) {
+            retireBatch(batch);
+        }
+    }
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [](const UploadBatch& batch) { return batch.fence == VK_NULL_HANDLE; }), pending.end());
+}
+
+bool UploadBatcher::isComplete(uint64_t ticket) {
+    if (ticket >= recording.ticket) {
+        return false;
+    }
+    update();
+    for (const UploadBatch& batch : pending) {
+        if (batch.ticket == ticket) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UploadBatcher::wait(uint64_t ticket) {
+    if (ticket >= recording.ticket) {
+        submit();
+    }
+    for (UploadBatch& batch : pending) {
+        if (batch.ticket <= ticket) {
+            waitForBatch(batch);
+        }
+    }
+    update();
+}
+
+void UploadBatcher::waitForBatch(UploadBatch& batch) {
+    if (!batch.graphicsSubmitted) {
+        vkWaitForFences(vkSetup->device, 1, &batch.transferFence, VK_TRUE, UINT64_MAX);
+        submitGraphics(batch);
+    }
+    vkWaitForFences(vkSetup->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+}
+
+void UploadBatcher::retireBatch(UploadBatch& batch) {
+    // the graphics part is only submitted once the copies are done, so its fence covers both
+    for (StagingRegion& region : batch.stagingRegions) {
+        stagingBuffer->free(region);
+    }
+    batch.stagingRegions.clear();
+    if (batch.transferCommandBuffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(vkSetup->device, transferCommandPool, 1, &batch.transferCommandBuffer);
+        vkDestroyFence(vkSetup->device, batch.transferFence, nullptr);
+        batch.transferCommandBuffer = VK_NULL_HANDLE;
+        batch.transferFence = VK_NULL_HANDLE;
+    }
+    vkFreeCommandBuffers(vkSetup->device, commandPool, 1, &batch.commandBuffer);
+    vkDestroyFence(vkSetup->device, batch.fence, nullptr);
+    batch.commandBuffer = VK_NULL_HANDLE;
+    batch.fence = VK_NULL_HANDLE;
+}
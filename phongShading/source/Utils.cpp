@@ -41,6 +41,22 @@ QueueFamilyIndices QueueFamilyIndices::findQueueFamilies(const VkPhysicalDevice
         // increment i to get index of next queue family
         i++;
     }
+
+    // a family with only transfer is preferred, otherwise an async compute family can copy too. The transfer bit is
+    // optional for families with graphics or compute, so it is only a dedicated family if it has it
+    for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transferFamily = family;
+            break;
+        }
+        if (!indices.transferFamily.has_value()) {
+            indices.transferFamily = family;
+        }
+    }
     return indices;
 }
 
@@ -111,7 +127,7 @@ void utils::endSingleTimeCommands(const VkDevice* device, const VkQueue* queue,
     vkFreeCommandBuffers(*device, *commandPool, 1, commandBuffer);
 }
 
-void utils::createImage(const VkDevice* device, const VkPhysicalDevice* physicalDevice, const CreateImageData& info) {
+void utils::createImage(const VkDevice* device, MemoryAllocator* allocator, const CreateImageData& info) {
     // create the struct for creating an image
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -119,7 +135,7 @@ void utils::createImage(const VkDevice* device, const VkPhysicalDevice* physical
     imageInfo.extent.width = info.width; // the dimensions of the image
     imageInfo.extent.height = info.height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1; // no mip mapping yet
+    imageInfo.mipLevels = info.mipLevels; // the full chain for textures, 1 for attachments
     imageInfo.arrayLayers = 1; // not in array yet
     imageInfo.format = info.format; // same format as the pixels is best
     imageInfo.tiling = info.tiling; // tiling of the pixels, let vulkan lay them out
@@ -139,22 +155,14 @@ void utils::createImage(const VkDevice* device, const VkPhysicalDevice* physical
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(*device, *info.image, &memRequirements);
 
-    // info on the allocation
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    // attempt to create an image
-    if (vkAllocateMemory(*device, &allocInfo, nullptr, info.imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
+    // a region of a larger block of memory, optimal images are kept apart from buffers to honour bufferImageGranularity
+    *info.imageMemory = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, info.tiling == VK_IMAGE_TILING_LINEAR);
 
     // associate the memory to the image
-    vkBindImageMemory(*device, *info.image, *info.imageMemory, 0);
+    vkBindImageMemory(*device, *info.image, info.imageMemory->memory, info.imageMemory->offset);
 }
 
-VkImageView utils::createImageView(const VkDevice* device, const VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags) {
+VkImageView utils::createImageView(const VkDevice* device, const VkImage& image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
     // helper function for creating image views with a specific format
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -170,7 +178,7 @@ VkImageView utils::createImageView(const VkDevice* device, const VkImage& image,
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     // and what part of the image we want
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels; // every level of the image
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -282,49 +290,11 @@ void utils::transitionImageLayout(const VkDevice* device, const VkQueue* graphic
 }
 
 //
-// Creating and copying buffers
+// Creating buffers
 //
 
-void utils::copyBufferToImage(const VkDevice* device, const VkQueue* queue, const VkCommandPool& renderCommandPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    // copying buffer to image
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, renderCommandPool);
-
-    // need to specify which parts of the buffer we are going to copy to which part of the image
-    VkBufferImageCopy region{};
-
-    // about the buffer area
-    region.bufferOffset = 0; // byte offset after which the pixels start
-    // how pixels are laid out in memory
-    region.bufferRowLength = 0; // 0 = tightly packed
-    region.bufferImageHeight = 0;
-
-    // about the image area, which part of te image we want to copy the pixels
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = {
-        width,
-        height,
-        1
-    };
-
-    // buffer to image copy operations are enqueued thus
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // which layout the image is currently using
-        1,
-        &region
-    );
-    endSingleTimeCommands(device, queue, &commandBuffer, &renderCommandPool);
-}
-
-void utils::createBuffer(const VkDevice* device, const VkPhysicalDevice* physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-    VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void utils::createBuffer(const VkDevice* device, MemoryAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkBuffer& buffer, MemoryAllocation& bufferMemory) {
     // fill in the corresponding struct
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -342,36 +312,11 @@ void utils::createBuffer(const VkDevice* device, const VkPhysicalDevice* physica
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(*device, buffer, &memRequirements);
 
-    // allocate the memory for the buffer
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = utils::findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-    // allocate memory for the buffer. In a real world application, not supposed to actually call vkAllocateMemory for every individual buffer. 
-    // The maximum number of simultaneous memory allocations is limited by the maxMemoryAllocationCount physical device limit. The right way to 
-    // allocate memory for large number of objects at the same time is to create a custom allocator that splits up a single allocation among many 
-    // different objects by using the offset parameters seen in other functions
-    if (vkAllocateMemory(*device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
+    // not a vkAllocateMemory for every individual buffer, the maximum number of simultaneous memory allocations is limited
+    // by the maxMemoryAllocationCount physical device limit. The allocator splits up large blocks among many buffers and
+    // images instead, each bound at its offset in the block
+    bufferMemory = allocator->allocate(memRequirements, properties, true);
 
     // associate memory with buffer
-    vkBindBufferMemory(*device, buffer, bufferMemory, 0);
+    vkBindBufferMemory(*device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
-
-void utils::copyBuffer(const VkDevice* device, const VkQueue* queue, const VkCommandPool& commandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    // memory transfer operations are executed using command buffers, like drawing commands. We need to allocate a temporary command buffer
-    // could use a command pool for these short lived operations using the flag VK_COMMAND_POOL_CREATE_TRANSIENT_BIT 
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
-    // defines the region of 
-    VkBufferCopy copyRegion{};
-    // offsets in the source and destination, we may want to keep certain values
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size; // can't be VK_WHOLE_SIZE here like vkMapMemory
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(device, queue, &commandBuffer, &commandPool);
-}
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <iostream> 
 #include <stdexcept>
 
+#include <algorithm> // min
 #include <set>
 #include <string>
 
@@ -36,11 +37,15 @@ void VulkanSetup::initSetup(GLFWwindow* theWindow) {
     pickPhysicalDevice();
     // create the logical device for interfacing with the physical device
     createLogicalDevice();
+    // then the allocator the device memory of every resource comes from
+    memoryAllocator.createMemoryAllocator(device, physicalDevice);
     // we got this far so signal that the setup was complete
     setupComplete = true;
 }
 
 void VulkanSetup::cleanupSetup() {
+    // every resource has been destroyed by now, release the blocks of memory they were in
+    memoryAllocator.cleanupMemoryAllocator();
     // remove the logical device, no direct interaction with instance so not passed as argument
     vkDestroyDevice(device, nullptr);
     // destroy the window surface
@@ -326,7 +331,9 @@ bool VulkanSetup::isDeviceSuitable(VkPhysicalDevice device) {
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
     // return the queue family index (true if a value was initialised), device supports extension and swap chain is adequate (phew)
-    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    // the draws pass their material index as the first instance, which indirect draws can only do with drawIndirectFirstInstance
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy
+        && supportedFeatures.drawIndirectFirstInstance && supportedFeatures.shaderSampledImageArrayDynamicIndexing;
 }
 
 bool VulkanSetup::checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -391,6 +398,11 @@ void VulkanSetup::createLogicalDevice() {
     // using a set makes sure that there are no dulpicate references to a same queue!
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
+    // the uploads get a queue of their own if the device has a transfer family
+    graphicsFamily = indices.graphicsFamily.value();
+    transferFamily = useTransferQueue && indices.transferFamily.has_value() ? indices.transferFamily.value() : graphicsFamily;
+    uniqueQueueFamilies.insert(transferFamily);
+
     // queue priority, for now give queues the same priority
     float queuePriority = 1.0f;
     // loop over the queue families in the set
@@ -408,6 +420,30 @@ void VulkanSetup::createLogicalDevice() {
     // queries support certain features (like geometry shaders, other things in the vulkan pipeline...)
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE; // we want the device to use anisotropic filtering if available
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE; // the material index of each indirect draw
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE; // the texture of each draw, picked from the texture table
+
+    // the properties are queried once here rather than by every object that needs one of the limits
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+    // as many textures in the table as the fragment shader can sample, up to the maximum
+    const VkPhysicalDeviceLimits& limits = deviceProperties.limits;
+    textureTableSize = std::min({ TEXTURE_TABLE_MAX_SIZE, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+        limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+
+    // several indirect draws in one command if the device can, otherwise the meshlet draws are issued one at a time
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    if (supportedFeatures.multiDrawIndirect) {
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        maxDrawIndirectCount = deviceProperties.limits.maxDrawIndirectCount;
+    }
+
+    // block compressed textures if the device can sample them, otherwise textures are decoded and uploaded as rgba8
+    if (supportedFeatures.textureCompressionBC) {
+        deviceFeatures.textureCompressionBC = VK_TRUE;
+        textureCompressionBC = true;
+    }
 
     // the struct containing the device info
     VkDeviceCreateInfo createInfo{};
@@ -439,4 +475,6 @@ void VulkanSetup::createLogicalDevice() {
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     // set the presentation queue handle like above
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    // and the transfer queue, which is the graphics queue without a transfer family
+    vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
 }
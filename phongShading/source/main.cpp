@@ -7,14 +7,44 @@
 #include <stdexcept>
 
 #include <cstdlib> // EXIT_SUCCES & EXIT_FAILURE macros
+#include <cstring> // strcmp
+#include <filesystem> // temporary directory for the benchmark, path of the cooked texture
 
 // include the application definition
 #include <DuckApplication.h>
 
-int main() {
+// obj parser benchmark
+#include <ObjParser.h>
+
+// offline texture cooking
+#include <TextureCooker.h>
+#include <BlockCompression.h>
+#include <Ktx2.h>
+
+int main(int argc, char* argv[]) {
     DuckApplication app;
 
     try {
+        if (argc > 1 && strcmp(argv[1], "--benchmark-obj") == 0) {
+            // compare the obj parsers on the duck and on a much larger generated mesh instead of running the application
+            std::string syntheticPath = (std::filesystem::temp_directory_path() / "synthetic.obj").string();
+            objparser::writeSyntheticObj(syntheticPath, OBJ_BENCHMARK_TRIANGLES);
+            objparser::runBenchmark({ MODEL_PATH, syntheticPath });
+            std::filesystem::remove(syntheticPath);
+            return EXIT_SUCCESS;
+        }
+
+        if (argc > 2 && strcmp(argv[1], "--cook-texture") == 0) {
+            // --cook-texture <image> [bc1|bc7] [refinements], writes the ktx2 file next to the image where the
+            // texture looks for it
+            std::string sourcePath = argv[2];
+            VkFormat format = texturecooker::formatFromName(argc > 3 ? argv[3] : "bc7");
+            uint32_t refinements = argc > 4 ? static_cast<uint32_t>(std::stoul(argv[4])) : BC_DEFAULT_REFINEMENTS;
+            std::string outputPath = std::filesystem::path(sourcePath).replace_extension(KTX2_EXTENSION).string();
+            texturecooker::cookTexture(sourcePath, outputPath, format, refinements);
+            return EXIT_SUCCESS;
+        }
+
         app.run();
     }
     catch (const std::exception& e) {
@@ -1,3 +1,4 @@
 C:/VulkanSDK/1.2.162.1/Bin/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/1.2.162.1/Bin/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.2.162.1/Bin/glslc.exe shaderPacked.vert -o vertPacked.spv
 pause
\ No newline at end of file
@@ -18,7 +18,24 @@ layout(binding = 0, std140) uniform UniformBufferObject {
     vec3 lightPos;
 } ubo;
 
-layout(binding = 1) uniform sampler2D texSampler; // equivalent sampler1D and sampler3D
+// the number of textures in the table, set when the pipeline is created as it depends on the device
+layout(constant_id = 0) const uint TEXTURE_TABLE_SIZE = 16;
+
+// every texture in use, indexed with the texture index of the material (equivalent sampler1D and sampler3D)
+layout(binding = 1) uniform sampler2D textures[TEXTURE_TABLE_SIZE];
+
+// a material of the table (mirrors Material), the colours multiply the light colours of the ubo
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; // w is the exponent, 0 to use the one of the ubo
+    uint textureIndex; // the slot of the texture in the texture table
+};
+
+// the material table of the model
+layout(binding = 2, std430) readonly buffer MaterialTable {
+    Material materials[];
+};
 
 //
 // Input from previous stage
@@ -26,7 +43,7 @@ layout(binding = 1) uniform sampler2D texSampler; // equivalent sampler1D and sa
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragNormal;
-layout(location = 2) in vec4 fragMaterial;
+layout(location = 2) flat in uint fragMaterialIndex;
 layout(location = 3) in vec2 fragTexCoord;
 
 //
@@ -45,10 +62,14 @@ void main()
         outColor = vec4(fragTexCoord, 0.0, -10.0);
     }
     else {
-        // the colour of the model without lighting
+        // the material of the draw
+        Material material = materials[fragMaterialIndex];
+
+        // the colour of the model without lighting. The material index is the same for the whole draw, so the index
+        // into the texture table is dynamically uniform
         vec3 color = vec3(0.5, 0.5, 0.5);
         if (ubo.useTexture == 1) {
-            color = texture(texSampler, fragTexCoord).rgb;
+            color = texture(textures[material.textureIndex], fragTexCoord).rgb;
         }
         // view direction, assumes eye is at the origin (which is the case)
         vec3 viewDir = normalize(-fragPos);
@@ -58,15 +79,16 @@ void main()
         vec3 reflectDir = reflect(-lightDir, fragNormal);
 
         // ambient
-        vec3 ambient = ubo.ambient;
+        vec3 ambient = ubo.ambient * material.ambient.rgb;
 
         // diffuse (lambertian)
         float diff = max(dot(lightDir, fragNormal), 0.0f);
-        vec3 diffuse = ubo.diffuse * diff;
+        vec3 diffuse = ubo.diffuse * material.diffuse.rgb * diff;
 
         // specular (glossy)
-        float spec = pow(max(dot(viewDir, reflectDir), 0.0f), ubo.specular.w);
-        vec3 specular = ubo.specular.xyz * spec;
+        float exponent = material.specular.w > 0.0f ? material.specular.w : ubo.specular.w;
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0f), exponent);
+        vec3 specular = ubo.specular.xyz * material.specular.rgb * spec;
 
 
         // vector multiplication is element wise <3
@@ -0,0 +1,40 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// the uniform buffer object
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// inputs specified in the vertex buffer streams (VertexPosition and PackedVertexAttributes), the formats already unpack the snorms and half floats
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inOctahedralNormal;
+layout(location = 3) in vec2 inTexCoord;
+
+// the shader output, same as the unpacked vertex shader
+layout(location = 0) out vec3 fragPos;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) flat out uint fragMaterialIndex;
+layout(location = 3) out vec2 fragTexCoord;
+
+// inverse of PackedVertexAttributes::octahedralEncode, folds the lower half of the octahedron back under the upper half
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// main function, entry point to the shader
+void main() {
+    vec4 pos = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = pos;
+    fragPos = pos.xyz;
+    fragNormal = octahedralDecode(inOctahedralNormal);
+    // each draw passes its material index as its first instance
+    fragMaterialIndex = uint(gl_InstanceIndex);
+    fragTexCoord = inTexCoord;
+}